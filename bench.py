@@ -0,0 +1,158 @@
+import argparse
+import csv
+import json
+import os
+import platform
+import re
+import shutil
+import statistics
+import subprocess
+import sys
+import time
+
+# Benchmark suite behind "make bench". Every graph is generated by ./gen in
+# bench/data/, then every step runs at every thread count, in bench/, and
+# the median of the repeats is kept. Results go to bench/results.csv and
+# bench/results.json, one record per (graph, threads, step, kernel).
+# wall_s is the wall time of the whole run, phase_s the time of the step
+# itself, read from the --metrics JSON of the executable (the "build" phase
+# for "ingest", "compress" for "compress", "solve" for "pagerank" and
+# "hits", "jaccard_a" plus "jaccard_h" for "jaccard").
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--scales', type=int, nargs='+', default=[14, 16, 18])
+parser.add_argument('--threads', type=int, nargs='+', default=[1, 2, 4])
+parser.add_argument('--models', nargs='+', default=['rmat', 'er'])
+parser.add_argument('--edge-factor', type=int, default=16)
+parser.add_argument('--seed', type=int, default=1)
+parser.add_argument('--repeat', type=int, default=3)
+parser.add_argument('--top-k', type=int, default=100)
+parser.add_argument('--out', default='bench')
+args = parser.parse_args()
+
+root = os.path.dirname(os.path.abspath(__file__))
+out = os.path.abspath(args.out)
+os.makedirs(os.path.join(out, 'data'), exist_ok=True)
+
+
+metrics_p = os.path.join(out, 'metrics.json')
+
+
+def run(cmd, metrics=True):
+    # The phases come from --metrics, in seconds
+    if metrics:
+        cmd = cmd[:1] + ['--metrics', metrics_p] + cmd[1:]
+    begin = time.perf_counter()
+    res = subprocess.run(cmd, cwd=out, stdout=subprocess.PIPE,
+                         stderr=subprocess.STDOUT, universal_newlines=True)
+    wall = time.perf_counter() - begin
+    if res.returncode != 0:
+        sys.stderr.write(res.stdout)
+        raise Exception('"%s" failed' % ' '.join(cmd))
+    phases = {}
+    if metrics:
+        with open(metrics_p) as f:
+            for p in json.load(f)['phases']:
+                phases[p['name']] = phases.get(p['name'], 0.) + p['seconds']
+    iters = re.findall(r'Iterations: (\d+)', res.stdout)
+    return wall, phases, int(iters[-1]) if iters else None
+
+
+def median_run(cmd, names):
+    walls, phases, iters = [], [], None
+    for _ in range(args.repeat):
+        wall, times, iters = run(cmd)
+        walls.append(wall)
+        phases.append(sum(times[n] for n in names))
+    return statistics.median(walls), statistics.median(phases), iters
+
+
+records = []
+for model in args.models:
+    for scale in args.scales:
+        name = '%s-%d' % (model, scale)
+        dataset = 'data/%s.txt' % name
+        if not os.path.exists(os.path.join(out, dataset)):
+            run([os.path.join(root, 'gen'), '-t', str(max(args.threads)),
+                 '-m', model, '-e', str(args.edge_factor), '-s',
+                 str(args.seed), str(scale), dataset], metrics=False)
+        graph = {'graph': name, 'model': model, 'scale': scale,
+                 'nodes': 1 << scale, 'edges': args.edge_factor << scale}
+
+        for t in args.threads:
+            def record(step, kernel, wall, phase, iters=None):
+                records.append(dict(graph, threads=t, step=step,
+                                    kernel=kernel, wall_s=round(wall, 6),
+                                    phase_s=round(phase, 6),
+                                    iterations=iters))
+                print('%-10s t=%-3d %-9s %-6s wall %10.6fs phase %10.6fs' %
+                      (name, t, step, kernel, wall, phase))
+
+            pr = [os.path.join(root, 'pagerank'), '-t', str(t)]
+            hits = [os.path.join(root, 'hits'), '-t', str(t)]
+
+            # The cache build, from scratch every time
+            walls, phases = [], []
+            for _ in range(args.repeat):
+                shutil.rmtree(os.path.join(out, 'PR_' + name), True)
+                wall, times, _ = run(pr + [dataset])
+                walls.append(wall)
+                phases.append(times['build'])
+            record('ingest', 'csr', statistics.median(walls),
+                   statistics.median(phases))
+            shutil.rmtree(os.path.join(out, 'HITS_' + name), True)
+            run(hits + [dataset])
+
+            # The build of the -z lists, from scratch every time
+            vb = [os.path.join(out, 'PR_' + name, f)
+                  for f in ('row_off.bin', 'col_ind.vb')]
+            walls, phases = [], []
+            for _ in range(args.repeat):
+                for f in vb:
+                    if os.path.exists(f):
+                        os.remove(f)
+                wall, times, _ = run(pr + ['-z', dataset])
+                walls.append(wall)
+                phases.append(times['compress'])
+            record('compress', 'vb', statistics.median(walls),
+                   statistics.median(phases))
+
+            # The solvers, once per kernel after a first run that builds
+            # the files of the kernel (the -z lists are already there)
+            for kernel, flags in (('csr', []), ('tiled', ['-k', 'tiled']),
+                                  ('vb', ['-z'])):
+                run(pr + flags + [dataset])
+                wall, phase, iters = median_run(pr + flags + [dataset],
+                                                ['solve'])
+                record('pagerank', kernel, wall, phase, iters)
+            for kernel, flags in (('csr', []), ('tiled', ['-k', 'tiled'])):
+                run(hits + flags + [dataset])
+                wall, phase, _ = median_run(hits + flags + [dataset],
+                                            ['solve'])
+                record('hits', kernel, wall, phase)
+            wall, phase, _ = median_run(hits + [dataset, str(args.top_k)],
+                                        ['jaccard_a', 'jaccard_h'])
+            record('jaccard', 'csr', wall, phase)
+
+fields = ['graph', 'model', 'scale', 'nodes', 'edges', 'threads', 'step',
+          'kernel', 'wall_s', 'phase_s', 'iterations']
+with open(os.path.join(out, 'results.csv'), 'w') as f:
+    writer = csv.DictWriter(f, fieldnames=fields)
+    writer.writeheader()
+    writer.writerows(records)
+
+try:
+    commit = subprocess.run(['git', 'rev-parse', 'HEAD'], cwd=root,
+                            stdout=subprocess.PIPE, stderr=subprocess.DEVNULL,
+                            universal_newlines=True).stdout.strip()
+except OSError:
+    commit = ''
+machine = {'host': platform.node(), 'cpu': platform.processor(),
+           'cores': os.cpu_count(), 'commit': commit,
+           'date': time.strftime('%Y-%m-%dT%H:%M:%S'),
+           'repeat': args.repeat, 'seed': args.seed,
+           'edge_factor': args.edge_factor}
+with open(os.path.join(out, 'results.json'), 'w') as f:
+    json.dump({'machine': machine, 'results': records}, f, indent=1)
+print('Results written to "%s" and "%s"' %
+      (os.path.join(out, 'results.csv'), os.path.join(out, 'results.json')))
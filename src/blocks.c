@@ -0,0 +1,297 @@
+#include <fcntl.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "blocks.h"
+
+/* Entries buffered per block while the blocks are written */
+#define BLOCK_WBUF 4096
+
+static long page_up(long size) {
+  return (size + CACHE_ALIGN - 1) / CACHE_ALIGN * CACHE_ALIGN;
+}
+
+static int write_all(int fd, const void *data, size_t len, long pos) {
+  const char *c = (const char *)data;
+  ssize_t w;
+
+  while (len > 0) {
+    if ((w = pwrite(fd, c, len, pos)) <= 0) return EXIT_FAILURE;
+    c += w;
+    len -= w;
+    pos += w;
+  }
+  return EXIT_SUCCESS;
+}
+
+static int read_all(int fd, void *data, size_t len, long pos) {
+  char *c = (char *)data;
+  ssize_t r;
+
+  while (len > 0) {
+    if ((r = pread(fd, c, len, pos)) <= 0) return EXIT_FAILURE;
+    c += r;
+    len -= r;
+    pos += r;
+  }
+  return EXIT_SUCCESS;
+}
+
+/* Length of the intervals for which node_bytes bytes per node of one
+ * interval, plus the read buffers of no_files block files, fit in mem
+ * bytes. Returns 0 if mem is too small */
+int block_interval(int no_nodes, size_t mem, size_t node_bytes,
+                   int no_files) {
+  size_t len;
+
+  if (mem <= (size_t)BLOCK_CHUNK * no_files) return 0;
+  len = (mem - (size_t)BLOCK_CHUNK * no_files) / node_bytes;
+  if (len > (size_t)no_nodes) len = no_nodes > 0 ? no_nodes : 1;
+  return (int)len;
+}
+
+/* Number of nodes in interval i */
+int block_len(const Block_file *bf, int i) {
+  long lo = (long)i * bf->hdr.interval;
+  long left = bf->hdr.no_nodes - lo;
+
+  return left < bf->hdr.interval ? (int)left : bf->hdr.interval;
+}
+
+/* Writes the blocks of the CSR matrix (row_ptr, col_ind), of cache_stamp()
+ * stamp. A first pass counts the entries of every block, a second one
+ * scatters the rows of one row interval at a time into per-block buffers,
+ * flushed in place. Both passes read the matrix in order */
+int write_blocks(const char path[], const eidx *row_ptr, const int *col_ind,
+                 int no_nodes, int interval, unsigned long stamp) {
+  Block_header hdr;
+  char tmp_path[DNAME + FNAME + 8];
+  int P = no_nodes > 0 ? (no_nodes + interval - 1) / interval : 1;
+  long no_blocks = (long)P * P;
+  long *offset = (long *)calloc(2 * no_blocks, sizeof(long));
+  long *count = offset + no_blocks;
+  Block_entry *wbuf, *e;
+  int *fill;
+  long *cursor;
+  long pos, b;
+  eidx ci;
+  int i, j, ri, lo, hi;
+  int fd;
+  int err = 0;
+
+  memset(&hdr, 0, sizeof(Block_header));
+  memcpy(hdr.magic, BLOCK_MAGIC, sizeof(hdr.magic));
+  hdr.no_entries = row_ptr[no_nodes];
+  hdr.no_nodes = no_nodes;
+  hdr.interval = interval;
+  hdr.no_intervals = P;
+  hdr.stamp = stamp;
+
+  for (ri = 0; ri < no_nodes; ++ri)
+    for (ci = row_ptr[ri]; ci < row_ptr[ri + 1]; ++ci)
+      ++count[(long)(ri / interval) * P + col_ind[ci] / interval];
+  pos = page_up(sizeof(Block_header) + 2 * no_blocks * sizeof(long));
+  for (b = 0; b < no_blocks; ++b) {
+    offset[b] = pos;
+    pos = page_up(pos + count[b] * (long)sizeof(Block_entry));
+  }
+
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+  if ((fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1) {
+    fprintf(stderr, " [ERROR] Cannot create file \"%s\"\n", tmp_path);
+    free(offset);
+    return EXIT_FAILURE;
+  }
+  wbuf = (Block_entry *)malloc(sizeof(Block_entry) * BLOCK_WBUF * P);
+  fill = (int *)calloc(P, sizeof(int));
+  cursor = (long *)malloc(sizeof(long) * P);
+
+  for (i = 0; i < P && !err; ++i) {
+    lo = i * interval;
+    hi = no_nodes - lo < interval ? no_nodes : lo + interval;
+    for (j = 0; j < P; ++j) cursor[j] = offset[(long)i * P + j];
+    for (ri = lo; ri < hi && !err; ++ri) {
+      for (ci = row_ptr[ri]; ci < row_ptr[ri + 1] && !err; ++ci) {
+        j = col_ind[ci] / interval;
+        e = wbuf + (size_t)j * BLOCK_WBUF + fill[j]++;
+        e->row = ri - lo;
+        e->col = col_ind[ci] - j * interval;
+        if (fill[j] == BLOCK_WBUF) {
+          err = write_all(fd, wbuf + (size_t)j * BLOCK_WBUF,
+                          sizeof(Block_entry) * BLOCK_WBUF, cursor[j]);
+          cursor[j] += sizeof(Block_entry) * BLOCK_WBUF;
+          fill[j] = 0;
+        }
+      }
+    }
+    for (j = 0; j < P && !err; ++j) {
+      err = write_all(fd, wbuf + (size_t)j * BLOCK_WBUF,
+                      sizeof(Block_entry) * fill[j], cursor[j]);
+      fill[j] = 0;
+    }
+  }
+  err = err || write_all(fd, &hdr, sizeof(Block_header), 0) ||
+        write_all(fd, offset, 2 * no_blocks * sizeof(long),
+                  sizeof(Block_header)) ||
+        ftruncate(fd, pos) != 0;
+  err = close(fd) != 0 || err;
+
+  free(offset);
+  free(wbuf);
+  free(fill);
+  free(cursor);
+  if (err || rename(tmp_path, path) != 0) {
+    fprintf(stderr, " [ERROR] Cannot write file \"%s\"\n", path);
+    remove(tmp_path);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/* Opens the blocks of the CSR matrix (row_ptr, col_ind), of cache_stamp()
+ * stamp, with intervals of interval nodes, writing them first if path does
+ * not hold them yet */
+int open_blocks(Block_file *bf, const char path[], const eidx *row_ptr,
+                const int *col_ind, int no_nodes, int interval,
+                unsigned long stamp) {
+  long no_blocks;
+  int ok;
+
+  memset(bf, 0, sizeof(Block_file));
+  bf->fd = open(path, O_RDONLY);
+  ok = bf->fd != -1 &&
+       read_all(bf->fd, &bf->hdr, sizeof(Block_header), 0) == EXIT_SUCCESS &&
+       memcmp(bf->hdr.magic, BLOCK_MAGIC, sizeof(bf->hdr.magic)) == 0 &&
+       bf->hdr.no_nodes == no_nodes && bf->hdr.interval == interval &&
+       bf->hdr.no_entries == row_ptr[no_nodes] && bf->hdr.stamp == stamp;
+  if (!ok) {
+    if (bf->fd != -1) close(bf->fd);
+    printf("Blocking matrix in intervals of %d nodes...\n", interval);
+    if (write_blocks(path, row_ptr, col_ind, no_nodes, interval, stamp) ==
+            EXIT_FAILURE ||
+        (bf->fd = open(path, O_RDONLY)) == -1 ||
+        read_all(bf->fd, &bf->hdr, sizeof(Block_header), 0) ==
+            EXIT_FAILURE) {
+      fprintf(stderr, " [ERROR] Cannot read blocks \"%s\"\n", path);
+      if (bf->fd != -1) close(bf->fd);
+      return EXIT_FAILURE;
+    }
+  }
+
+  no_blocks = (long)bf->hdr.no_intervals * bf->hdr.no_intervals;
+  bf->offset = (long *)malloc(2 * no_blocks * sizeof(long));
+  bf->count = bf->offset + no_blocks;
+  if (read_all(bf->fd, bf->offset, 2 * no_blocks * sizeof(long),
+               sizeof(Block_header)) == EXIT_FAILURE ||
+      posix_memalign((void **)&bf->buf, CACHE_ALIGN, BLOCK_CHUNK) != 0) {
+    fprintf(stderr, " [ERROR] Cannot read blocks \"%s\"\n", path);
+    close_blocks(bf);
+    return EXIT_FAILURE;
+  }
+  posix_fadvise(bf->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  return EXIT_SUCCESS;
+}
+
+void close_blocks(Block_file *bf) {
+  if (bf->fd != -1) close(bf->fd);
+  free(bf->offset);
+  free(bf->buf);
+  memset(bf, 0, sizeof(Block_file));
+  bf->fd = -1;
+}
+
+/* acc[row] += x[col] over the n entries of e, sorted by row. Every thread
+ * takes a contiguous range, moved to row boundaries so that no two threads
+ * add to the same row */
+static void gather_chunk(const Block_entry *e, long n, const real *x,
+                         double *acc, int no_threads) {
+  if (n < no_threads * 4096L) no_threads = 1;
+
+#pragma omp parallel num_threads(no_threads)
+  {
+    int t = omp_get_thread_num(), nt = omp_get_num_threads();
+    long lo = n * t / nt, hi = n * (t + 1) / nt;
+    long k;
+
+    while (lo > 0 && lo < n && e[lo].row == e[lo - 1].row) ++lo;
+    while (hi > 0 && hi < n && e[hi].row == e[hi - 1].row) ++hi;
+    for (k = lo; k < hi; ++k) acc[e[k].row] += x[e[k].col];
+  }
+}
+
+/* acc += block (i, j) @ x, where acc covers row interval i and x column
+ * interval j. The block is read in chunks of BLOCK_CHUNK bytes, which are
+ * dropped from the page cache once used: the next sweep is far away, and
+ * the vector files are better kept there instead */
+int block_gather(Block_file *bf, int i, int j, const real *x, double *acc,
+                 int no_threads) {
+  long b = (long)i * bf->hdr.no_intervals + j;
+  long pos = bf->offset[b], left = bf->count[b];
+  long max = BLOCK_CHUNK / sizeof(Block_entry);
+  long n;
+
+  while (left > 0) {
+    n = left < max ? left : max;
+    if (read_all(bf->fd, bf->buf, n * sizeof(Block_entry), pos) ==
+        EXIT_FAILURE)
+      return EXIT_FAILURE;
+    gather_chunk(bf->buf, n, x, acc, no_threads);
+    posix_fadvise(bf->fd, pos, n * sizeof(Block_entry), POSIX_FADV_DONTNEED);
+    pos += n * sizeof(Block_entry);
+    left -= n;
+  }
+  return EXIT_SUCCESS;
+}
+
+/* Reads/writes the len values of a vector file from node lo on */
+int read_slice(int fd, real *x, long lo, int len) {
+  return read_all(fd, x, sizeof(real) * len, lo * (long)sizeof(real));
+}
+
+int write_slice(int fd, const real *x, long lo, int len) {
+  return write_all(fd, x, sizeof(real) * len, lo * (long)sizeof(real));
+}
+
+/* Creates the vector file path of no_nodes values, all set to value. x is
+ * a work buffer of one interval */
+int create_vector(const char path[], const Block_file *bf, real value,
+                  real *x) {
+  int fd, i, k;
+  int err = 0;
+
+  if ((fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600)) == -1) {
+    fprintf(stderr, " [ERROR] Cannot create file \"%s\"\n", path);
+    return -1;
+  }
+  for (k = 0; k < bf->hdr.interval; ++k) x[k] = value;
+  for (i = 0; i < bf->hdr.no_intervals && !err; ++i)
+    err = write_slice(fd, x, (long)i * bf->hdr.interval, block_len(bf, i));
+  if (err) {
+    fprintf(stderr, " [ERROR] Cannot write file \"%s\"\n", path);
+    close(fd);
+    remove(path);
+    return -1;
+  }
+  return fd;
+}
+
+/* Writes the vector file fd of no_nodes values as write_scores() does */
+int save_vector(int fd, int no_nodes, const int *perm, const char out_path[],
+                const char *phase) {
+  const real *v;
+  int err;
+
+  if (no_nodes == 0) return write_scores(out_path, NULL, 0, perm, phase);
+  v = (const real *)mmap(NULL, sizeof(real) * no_nodes, PROT_READ,
+                         MAP_SHARED, fd, 0);
+  if (v == MAP_FAILED) return EXIT_FAILURE;
+  err = write_scores(out_path, v, no_nodes, perm, phase);
+  munmap((void *)v, sizeof(real) * no_nodes);
+  return err;
+}
@@ -0,0 +1,57 @@
+#ifndef BLOCKS_H
+#define BLOCKS_H
+
+#include "utils.h"
+
+/* Out-of-core form of a CSR matrix (GraphChi/X-Stream style). The nodes are
+ * split into intervals of `interval` nodes and the entries are stored by
+ * (row interval, column interval) block, as pairs of ids local to their
+ * intervals, sorted by row within a block. Blocks are stored row interval
+ * major and start on a page boundary: a product sweeps the file once,
+ * sequentially, with only one interval of every vector in memory */
+#define BLOCK_MAGIC "IRWSBLK"
+#define BLOCK_CHUNK (1 << 24)
+
+typedef struct {
+  int row, col;
+} Block_entry;
+
+typedef struct {
+  char magic[8];
+  long no_entries;
+  int no_nodes;
+  int interval;
+  int no_intervals;
+  /* cache_stamp() of the graph cache the matrix comes from */
+  unsigned long stamp;
+} Block_header;
+
+typedef struct {
+  int fd;
+  Block_header hdr;
+  /* Byte offset and number of entries of block (i, j), at
+   * i * no_intervals + j */
+  long *offset, *count;
+  /* Page aligned read buffer of BLOCK_CHUNK bytes */
+  Block_entry *buf;
+} Block_file;
+
+int block_interval(int no_nodes, size_t mem, size_t node_bytes,
+                   int no_files);
+int block_len(const Block_file *bf, int i);
+int write_blocks(const char path[], const eidx *row_ptr, const int *col_ind,
+                 int no_nodes, int interval, unsigned long stamp);
+int open_blocks(Block_file *bf, const char path[], const eidx *row_ptr,
+                const int *col_ind, int no_nodes, int interval,
+                unsigned long stamp);
+void close_blocks(Block_file *bf);
+int block_gather(Block_file *bf, int i, int j, const real *x, double *acc,
+                 int no_threads);
+int read_slice(int fd, real *x, long lo, int len);
+int write_slice(int fd, const real *x, long lo, int len);
+int create_vector(const char path[], const Block_file *bf, real value,
+                  real *x);
+int save_vector(int fd, int no_nodes, const int *perm, const char out_path[],
+                const char *phase);
+
+#endif
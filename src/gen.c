@@ -0,0 +1,193 @@
+#include <getopt.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Synthetic graphs for the benchmarks, written as SNAP edge lists.
+ * "rmat" draws every edge by descending 2^scale x 2^scale quadrants with
+ * the Graph500 probabilities, then scrambles the node ids so that the hubs
+ * are not all low ids; "er" draws both ends uniformly (Erdos-Renyi
+ * G(n, m), with repetitions). The edges are drawn in blocks of BLOCK_EDGES
+ * with one random stream per block, so the output only depends on the
+ * seed, not on the number of threads */
+#define BLOCK_EDGES (1 << 16)
+#define MAX_SCALE 30
+
+/* R-MAT quadrant probabilities, d being the rest */
+#define RMAT_A 0.57
+#define RMAT_B 0.19
+#define RMAT_C 0.19
+
+/* Longest line: two node ids of 10 digits, a tab and a newline */
+#define LINE_MAX_LEN 24
+
+static unsigned long splitmix64(unsigned long *state) {
+  unsigned long z = (*state += 0x9e3779b97f4a7c15UL);
+
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9UL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebUL;
+  return z ^ (z >> 31);
+}
+
+/* Uniform in [0, 1) */
+static double uniform(unsigned long *state) {
+  return (double)(splitmix64(state) >> 11) * (1. / 9007199254740992.);
+}
+
+/* A bijection of [0, 2^scale) */
+static unsigned long scramble(unsigned long v, int scale) {
+  unsigned long mask = (1UL << scale) - 1;
+
+  v ^= v >> (scale / 2 + 1);
+  v = (v * 0x2545f4914f6cdd1dUL) & mask;
+  v ^= v >> (scale / 2 + 1);
+  v = (v * 0x9e3779b97f4a7c15UL + 0x632be59bd9b4e019UL) & mask;
+  return v;
+}
+
+static void rmat_edge(unsigned long *state, int scale, unsigned long *src,
+                      unsigned long *dst) {
+  unsigned long u = 0, v = 0;
+  double r;
+  int l;
+
+  for (l = 0; l < scale; ++l) {
+    r = uniform(state);
+    u <<= 1;
+    v <<= 1;
+    if (r >= RMAT_A + RMAT_B) u |= 1;
+    if ((r >= RMAT_A && r < RMAT_A + RMAT_B) ||
+        r >= RMAT_A + RMAT_B + RMAT_C)
+      v |= 1;
+  }
+  *src = scramble(u, scale);
+  *dst = scramble(v, scale);
+}
+
+/* Writes the edges of block b, at most BLOCK_EDGES of them, to out as text
+ * lines. Returns the number of chars written */
+static size_t write_block(char *out, long b, long no_edges, int rmat,
+                         int scale, unsigned long seed) {
+  unsigned long state = seed ^ (0xd1b54a32d192ed03UL * (b + 1UL));
+  unsigned long no_nodes = 1UL << scale, src, dst;
+  long e, end = (b + 1) * (long)BLOCK_EDGES;
+  size_t len = 0;
+
+  if (end > no_edges) end = no_edges;
+  for (e = b * (long)BLOCK_EDGES; e < end; ++e) {
+    if (rmat) {
+      rmat_edge(&state, scale, &src, &dst);
+    } else {
+      src = splitmix64(&state) % no_nodes;
+      dst = splitmix64(&state) % no_nodes;
+    }
+    len += sprintf(out + len, "%lu\t%lu\n", src, dst);
+  }
+  return len;
+}
+
+int main(int argc, char *argv[]) {
+  const char *model = "rmat";
+  const char *path;
+  unsigned long seed = 1;
+  long edge_factor = 16, no_edges, no_blocks, b, lo, hi;
+  int no_threads = 1;
+  int scale;
+  int rmat;
+  int opt;
+  char **bufs;
+  size_t *lens;
+  FILE *pf;
+  int err = 0;
+
+  while ((opt = getopt(argc, argv, "t:m:e:s:")) != -1) {
+    switch (opt) {
+      case 't':
+        if (sscanf(optarg, "%d", &no_threads) != 1 || no_threads < 1) {
+          fprintf(stderr, " [ERROR] Invalid number of threads \"%s\"\n",
+                  optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      case 'm':
+        if (strcmp(optarg, "rmat") != 0 && strcmp(optarg, "er") != 0) {
+          fprintf(stderr, " [ERROR] Unknown model \"%s\"\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        model = optarg;
+        break;
+      case 'e':
+        if (sscanf(optarg, "%ld", &edge_factor) != 1 || edge_factor < 1) {
+          fprintf(stderr, " [ERROR] Invalid edge factor \"%s\"\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      case 's':
+        if (sscanf(optarg, "%lu", &seed) != 1) {
+          fprintf(stderr, " [ERROR] Invalid seed \"%s\"\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      default:
+        fprintf(stderr,
+                " [ERROR] Usage: ./gen [-t <threads>] [-m rmat|er] "
+                "[-e <edge_factor>] [-s <seed>] <scale> <out_file>\n");
+        exit(EXIT_FAILURE);
+    }
+  }
+  if (argc - optind != 2) {
+    fprintf(stderr,
+            " [ERROR] *2* arguments required: ./gen <scale> <out_file>\n");
+    exit(EXIT_FAILURE);
+  }
+  if (sscanf(argv[optind], "%d", &scale) != 1 || scale < 1 ||
+      scale > MAX_SCALE) {
+    fprintf(stderr, " [ERROR] Invalid scale \"%s\", from 1 to %d\n",
+            argv[optind], MAX_SCALE);
+    exit(EXIT_FAILURE);
+  }
+  path = argv[optind + 1];
+  rmat = strcmp(model, "rmat") == 0;
+  no_edges = edge_factor << scale;
+  no_blocks = (no_edges + BLOCK_EDGES - 1) / BLOCK_EDGES;
+
+  if ((pf = fopen(path, "w")) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot create file \"%s\"\n", path);
+    exit(EXIT_FAILURE);
+  }
+  fprintf(pf, "# Directed graph\n");
+  fprintf(pf, "# %s graph, scale %d, edge factor %ld, seed %lu\n",
+          rmat ? "R-MAT" : "Erdos-Renyi", scale, edge_factor, seed);
+  fprintf(pf, "# Nodes: %d Edges: %ld\n", 1 << scale, no_edges);
+  fprintf(pf, "# FromNodeId\tToNodeId\n");
+
+  /* Every thread formats one block of a round, and the round is written in
+   * order */
+  bufs = (char **)malloc(sizeof(char *) * no_threads);
+  lens = (size_t *)malloc(sizeof(size_t) * no_threads);
+  for (b = 0; b < no_threads; ++b)
+    bufs[b] = (char *)malloc((size_t)BLOCK_EDGES * LINE_MAX_LEN);
+  for (lo = 0; lo < no_blocks && !err; lo += no_threads) {
+    hi = lo + no_threads < no_blocks ? lo + no_threads : no_blocks;
+#pragma omp parallel for num_threads(no_threads)
+    for (b = lo; b < hi; ++b)
+      lens[b - lo] =
+          write_block(bufs[b - lo], b, no_edges, rmat, scale, seed);
+    for (b = lo; b < hi && !err; ++b)
+      err = fwrite(bufs[b - lo], 1, lens[b - lo], pf) != lens[b - lo];
+  }
+  err = fclose(pf) != 0 || err;
+
+  for (b = 0; b < no_threads; ++b) free(bufs[b]);
+  free(bufs);
+  free(lens);
+  if (err) {
+    fprintf(stderr, " [ERROR] Cannot write file \"%s\"\n", path);
+    remove(path);
+    exit(EXIT_FAILURE);
+  }
+  printf("%s graph of %d nodes and %ld edges written to \"%s\"\n",
+         rmat ? "R-MAT" : "Erdos-Renyi", 1 << scale, no_edges, path);
+  exit(EXIT_SUCCESS);
+}
@@ -1,138 +1,268 @@
 #include <dirent.h>
 #include <fcntl.h>
-#include <float.h>
-#include <math.h>
+#include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
-#include <sys/stat.h>
 #include <sys/types.h>
-#include <time.h>
 #include <unistd.h>
 
+#include "irws.h"
 #include "jaccard.h"
-#include "utils.h"
+#include "metrics.h"
+#include "minhash.h"
 
-typedef CSR_data LCSR_data;
-
-/* Data to save/load LCSR matrix */
+/* Cache and result file names */
 char fname[FNAME] = {0};
 char dir[DNAME] = {0};
-char lcsr_data_p[PATH] = {0};
-LCSR_data lcsr_data = {0};
-int no_nodes = 0, no_edges = 0;
-
-/*   Matrix L               Matrix L^T           */
-char row_ptr_p[PATH] = {0}, row_ptr_tp[PATH] = {0};
-char col_ind_p[PATH] = {0}, col_ind_tp[PATH] = {0};
-
-/* HITS computation data */
-double *a = NULL;
-double *h = NULL;
 char fauth[FNAME] = {0};
 char fhub[FNAME] = {0};
-
-/* LCSR matrix representation */
-int *col_ind = NULL, *col_ind_t = NULL;
-int *row_ptr = NULL, *row_ptr_t = NULL;
-
-void perform_compression(const char dataset_path[FNAME]);
-void compute_hits(void);
+char ftop_a[PATH] = {0};
+char ftop_h[PATH] = {0};
+char ftop_a_csv[PATH] = {0};
+char ftop_h_csv[PATH] = {0};
+char fjoin[PATH] = {0};
+int no_threads = 1;
+
+/* Node reordering applied at compression time */
+char order_method[FNAME] = {0};
+
+/* Edge delta merged into the cache before the computation, which then
+ * starts from the previous result */
+char delta_p[PATH] = {0};
+
+/* Reference results to compare against */
+char ref_dir[DNAME] = {0};
+char fref_a[DNAME + FNAME] = {0};
+char fref_h[DNAME + FNAME] = {0};
+
+/* Use the gap/varint compressed col_ind/col_ind_t */
+int compressed = 0;
+
+/* Kernel of the products: "csr" (the plain rows) or "tiled" (the rows cut
+ * in cache-sized tiles of columns) */
+int tiled = 0;
+
+/* Memory budget in MB of the out-of-core solver, 0 to solve in memory */
+long mem_mb = 0;
+
+/* Length of the ranked lists written with --top, 0 for none */
+int rank_K = 0;
+
+/* Whether the Jaccard coefficients also go to a CSV file and to stdout */
+int jac_text = 0;
+
+/* Threshold of the similarity join with --join (on the in-links) or
+ * --join-out (on the out-links), 0 for none */
+double join_t = 0.;
+int join_out = 0;
+
+/* JSON file the phase and iteration metrics are written to with
+ * --metrics, with the hardware counters if --counters is given */
+char metrics_p[PATH] = {0};
+int counters = 0;
+
+/* Check every section of the cache against its checksum before use, a
+ * full read of the cache that -m runs are meant to avoid */
+int verify = 0;
+
+/* Long options, returned by getopt_long() past the range of chars */
+#define OPT_TOP 256
+#define OPT_CSV 257
+#define OPT_JOIN 258
+#define OPT_JOIN_OUT 259
+#define OPT_METRICS 260
+#define OPT_COUNTERS 261
+#define OPT_VERIFY 262
+static const struct option long_opts[] = {
+    {"top", required_argument, NULL, OPT_TOP},
+    {"csv", no_argument, NULL, OPT_CSV},
+    {"join", required_argument, NULL, OPT_JOIN},
+    {"join-out", required_argument, NULL, OPT_JOIN_OUT},
+    {"metrics", required_argument, NULL, OPT_METRICS},
+    {"counters", no_argument, NULL, OPT_COUNTERS},
+    {"verify", no_argument, NULL, OPT_VERIFY},
+    {NULL, 0, NULL, 0}};
+
+static void close_metrics(void) { metrics_close(); }
 
 int main(int argc, char *argv[]) {
-  /* File IO */
-  FILE *pf;
-  ssize_t bytes;
+  /* Graph and HITS vectors */
+  HITS_graph g;
+  real *a, *h;
+  int *ids = NULL;
 
   /* Extra data */
+  const char *dataset = NULL;
   int err;
+  char cache_p[DNAME + FNAME];
+  int status, flags;
+  int opt;
   int i;
   int top_K = 0;
-  struct stat st = {0};
+  char c;
+
+  while ((opt = getopt_long(argc, argv, "t:r:zo:u:m:k:", long_opts,
+                            NULL)) != -1) {
+    switch (opt) {
+      case 't':
+        if (sscanf(optarg, "%d", &no_threads) != 1 || no_threads < 1) {
+          fprintf(stderr, " [ERROR] Invalid number of threads \"%s\"\n",
+                  optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      case 'r':
+        strncpy(ref_dir, optarg, DNAME - 1);
+        break;
+      case 'z':
+        compressed = 1;
+        break;
+      case 'o':
+        strncpy(order_method, optarg, FNAME - 1);
+        break;
+      case 'k':
+        if (strcmp(optarg, "csr") != 0 && strcmp(optarg, "tiled") != 0) {
+          fprintf(stderr, " [ERROR] Unknown kernel \"%s\"\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        tiled = strcmp(optarg, "tiled") == 0;
+        break;
+      case 'u':
+        strncpy(delta_p, optarg, PATH - 1);
+        break;
+      case 'm':
+        if (sscanf(optarg, "%ld", &mem_mb) != 1 || mem_mb < 1) {
+          fprintf(stderr, " [ERROR] Invalid memory budget \"%s\"\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      case OPT_TOP:
+        if (sscanf(optarg, "%d", &rank_K) != 1 || rank_K < 1) {
+          fprintf(stderr, " [ERROR] Invalid top-K \"%s\"\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      case OPT_CSV:
+        jac_text = 1;
+        break;
+      case OPT_JOIN:
+      case OPT_JOIN_OUT:
+        if (sscanf(optarg, "%lf", &join_t) != 1 || join_t <= 0. ||
+            join_t > 1.) {
+          fprintf(stderr, " [ERROR] Invalid join threshold \"%s\"\n",
+                  optarg);
+          exit(EXIT_FAILURE);
+        }
+        join_out = opt == OPT_JOIN_OUT;
+        break;
+      case OPT_METRICS:
+        strncpy(metrics_p, optarg, PATH - 1);
+        break;
+      case OPT_COUNTERS:
+        counters = 1;
+        break;
+      case OPT_VERIFY:
+        verify = 1;
+        break;
+      default:
+        fprintf(stderr,
+                " [ERROR] Usage: ./hits [-t <threads>] [-r <ref_dir>] [-z] "
+                "[-o degree|rcm] [-k csr|tiled] [-u <delta_file>] [-m <MB>] "
+                "[--top <K>] [--csv] [--join|--join-out <t>] "
+                "[--verify] [--metrics <json_file> [--counters]] "
+                "<arg_name> [<K>]\n");
+        exit(EXIT_FAILURE);
+    }
+  }
 
-  if (argc != 2 && argc != 3) {
-    fprintf(stderr,
-            " [ERROR] *1* argument required: ./pagerank <arg_name> [<K>]\n");
+  if (argc - optind != 1 && argc - optind != 2) {
+    fprintf(stderr, " [ERROR] *1* argument required: ./hits [<options>] "
+                    "<arg_name> [<K>]\n");
     exit(EXIT_FAILURE);
   }
+  dataset = argv[optind];
+  if (argc - optind > 1 && (sscanf(argv[optind + 1], "%d%c", &top_K, &c) != 1 ||
+                            top_K < 1)) {
+    fprintf(stderr, " [ERROR] Invalid K \"%s\"\n", argv[optind + 1]);
+    exit(EXIT_FAILURE);
+  }
+  if (compressed && tiled) {
+    fprintf(stderr, " [ERROR] -z and -k tiled cannot be used together\n");
+    exit(EXIT_FAILURE);
+  }
+  if (metrics_p[0] != '\0') {
+    if (metrics_open(metrics_p, "hits", dataset, no_threads, counters) ==
+        EXIT_FAILURE)
+      exit(EXIT_FAILURE);
+    atexit(close_metrics);
+  }
 
   /* Init data folder name */
-  strncpy(fname, argv[1] + 5, strlen(argv[1]) - 9);
-  fname[strlen(argv[1]) - 8] = '\0';
+  strncpy(fname, dataset + 5, strlen(dataset) - 9);
+  fname[strlen(dataset) - 8] = '\0';
   strcpy(dir, "HITS_");
   dir[5] = '\0';
   strcat(dir, fname);
   dir[5 + strlen(fname)] = '/';
   dir[5 + strlen(fname) + 1] = '\0';
 
-  /* Create LCSR file names */
-  strcpy(row_ptr_p, dir);
-  strcat(row_ptr_p, "row_ptr.bin");
-  strcpy(col_ind_p, dir);
-  strcat(col_ind_p, "col_ind.bin");
-
-  /* Create transposed LCSR file names */
-  strcpy(row_ptr_tp, dir);
-  strcat(row_ptr_tp, "row_ptr_t.bin");
-  strcpy(col_ind_tp, dir);
-  strcat(col_ind_tp, "col_ind_t.bin");
-
-  /* Create LCSR metadata file */
-  strcpy(lcsr_data_p, dir);
-  strcat(lcsr_data_p, "lcsr_data.bin");
-
   /* Create file to save HITS result */
   strcpy(fauth, fname);
   strcat(fauth, "_a.hits");
   strcpy(fhub, fname);
   strcat(fhub, "_h.hits");
-
-  /* Check if input data has already been compressed.
-   * If data has NOT yet been compressed, then perform compression */
-  if (stat(dir, &st) == -1) {
-    perform_compression(argv[1]);
+  sprintf(ftop_a, "%s_a.top", fname);
+  sprintf(ftop_h, "%s_h.top", fname);
+  sprintf(ftop_a_csv, "%s_a_top.csv", fname);
+  sprintf(ftop_h_csv, "%s_h_top.csv", fname);
+  sprintf(fjoin, "%s_join%s.csv", fname, join_out ? "_out" : "");
+  sprintf(fref_a, "%s/%s", ref_dir, fauth);
+  sprintf(fref_h, "%s/%s", ref_dir, fhub);
+
+  /* The input is compressed when it has no cache yet, and again when the
+   * cache is older than the input or incomplete */
+  strcpy(cache_p, dir);
+  strcat(cache_p, CACHE_FILE);
+  status = cache_check(cache_p, dataset);
+  if (status == CACHE_STALE)
+    printf("\"%s\" changed since \"%s\" was built\n", dataset, cache_p);
+  else if (status == CACHE_INVALID)
+    printf("\"%s\" is incomplete or from another version\n", cache_p);
+  if (status != CACHE_OK) {
+    if (hits_build(dataset, dir, order_method, no_threads, 1) == EXIT_FAILURE)
+      exit(EXIT_FAILURE);
+  } else if (order_method[0] != '\0') {
+    printf("Data already compressed, \"-o %s\" is ignored\n\n",
+           order_method);
   }
+  if (delta_p[0] != '\0' &&
+      hits_update(dir, delta_p, no_threads, 1) == EXIT_FAILURE)
+    exit(EXIT_FAILURE);
 
-  /* Reading LCSR matrix metadata info from file */
+  /* mmapping the LCSR matrices data from the cache file. A damaged cache
+   * is rebuilt, sections that do not match their checksum being only found
+   * with --verify, unless it was just updated */
   printf("Reading CLSR matrix data...\n");
-  pf = fopen(lcsr_data_p, "rb");
-  bytes = fread(&no_nodes, sizeof(lcsr_data.no_nodes), 1, pf);
-  bytes = fread(&no_edges, sizeof(lcsr_data.no_edges), 1, pf);
-  (void)bytes;
-  fclose(pf);
-  printf("no_nodes: %d\nno_edges: %d\n\n", no_nodes, no_edges);
-
-  /* mmapping the CSR matrix data from files */
-  err = 0;
-  if ((row_ptr = (int *)mmap_data(row_ptr_p, sizeof(int), no_nodes + 1)) ==
-      MAP_FAILED) {
-    ++err;
-  } else if ((row_ptr_t = (int *)mmap_data(row_ptr_tp, sizeof(int),
-                                           no_nodes + 1)) == MAP_FAILED) {
-    ++err;
-  } else if ((col_ind = (int *)mmap_data(col_ind_p, sizeof(int), no_edges)) ==
-             MAP_FAILED) {
-    ++err;
-  } else if ((col_ind_t = (int *)mmap_data(col_ind_tp, sizeof(int),
-                                           no_edges)) == MAP_FAILED) {
-    ++err;
-  }
-
-  if (err > 0) {
-    fprintf(stderr, " [ERROR] data could not be mmapped from memory.\n");
-    fprintf(stderr,
-            "         Data is corrupted, the folder will be destroyed.\n");
-    delete_folder(dir);
-    /* Un-mmaping mmapped files */
-    if (row_ptr == MAP_FAILED) munmap(row_ptr, (no_nodes + 1) * sizeof(int));
-    if (row_ptr_t == MAP_FAILED)
-      munmap(row_ptr_t, (no_nodes + 1) * sizeof(int));
-    if (col_ind == MAP_FAILED) munmap(col_ind, no_edges * sizeof(int));
-    if (col_ind_t == MAP_FAILED) munmap(col_ind_t, no_edges * sizeof(int));
-    exit(EXIT_FAILURE);
+  flags = (verify ? IRWS_VERIFY : 0) | (compressed ? IRWS_COMPRESSED : 0) |
+          (tiled ? IRWS_TILED : 0);
+  if (hits_open(&g, dir, flags, no_threads) == EXIT_FAILURE) {
+    /* A rebuild would silently drop every delta merged so far, not only
+     * this one */
+    if (delta_p[0] != '\0') {
+      fprintf(stderr,
+              " [ERROR] Cannot open \"%s\" after the update, rebuild it "
+              "from an edge list that includes the merged deltas\n",
+              dir);
+      exit(EXIT_FAILURE);
+    }
+    fprintf(stderr, "         Rebuilding \"%s\"...\n", dir);
+    if (hits_build(dataset, dir, order_method, no_threads, 1) == EXIT_FAILURE ||
+        hits_open(&g, dir, flags, no_threads) == EXIT_FAILURE)
+      exit(EXIT_FAILURE);
   }
-
+  printf("no_nodes: %d\nno_edges: %ld\n\n", g.no_nodes, (long)g.no_edges);
   printf("Done.\n\n");
 
 #ifdef DEBUG
@@ -140,14 +270,14 @@ int main(int argc, char *argv[]) {
   printf("---------------------\n");
 
   printf("col_ind: [ ");
-  for (i = 0; i < no_edges; ++i) {
-    printf("%d ", col_ind[i]);
+  for (i = 0; i < g.no_edges; ++i) {
+    printf("%d ", g.col_ind[i]);
   }
   printf("]\n");
 
   printf("row_ptr: [ ");
-  for (i = 0; i < no_nodes + 1; ++i) {
-    printf("%d ", row_ptr[i]);
+  for (i = 0; i < g.no_nodes + 1; ++i) {
+    printf("%ld ", (long)g.row_ptr[i]);
   }
   printf("]\n\n");
 
@@ -155,319 +285,136 @@ int main(int argc, char *argv[]) {
   printf("---------------------\n");
 
   printf("col_ind_t: [ ");
-  for (i = 0; i < no_edges; ++i) {
-    printf("%d ", col_ind_t[i]);
+  for (i = 0; i < g.no_edges; ++i) {
+    printf("%d ", g.col_ind_t[i]);
   }
   printf("]\n");
 
   printf("row_ptr_t: [ ");
-  for (i = 0; i < no_nodes + 1; ++i) {
-    printf("%d ", row_ptr_t[i]);
+  for (i = 0; i < g.no_nodes + 1; ++i) {
+    printf("%ld ", (long)g.row_ptr_t[i]);
   }
   printf("]\n\n");
 #endif
 
+  /* The join only needs the adjacency lists, it is done before solving.
+   * The rows of L^T are sorted, those of L are not */
+  if (join_t > 0.) {
+    if (g.perm != NULL) {
+      ids = (int *)malloc(sizeof(int) * g.no_nodes);
+      for (i = 0; i < g.no_nodes; ++i) ids[g.perm[i]] = i;
+    }
+    err = similarity_join(join_out ? g.row_ptr : g.row_ptr_t,
+                          join_out ? g.col_ind : g.col_ind_t, g.no_nodes,
+                          !join_out, join_t, ids, fjoin, no_threads, 1) ==
+          EXIT_FAILURE;
+    free(ids);
+    ids = NULL;
+    if (err) {
+      hits_close(&g);
+      exit(EXIT_FAILURE);
+    }
+    printf("Similar pairs written to \"%s\"\n\n", fjoin);
+  }
+
+  /* Out of core, the scores are never held in memory: they are written
+   * directly, and the top-K Jaccard coefficients, which need them, are not
+   * computed */
+  if (mem_mb > 0) {
+    if (argc - optind > 1 || ref_dir[0] != '\0')
+      printf("\"<K>\" and \"-r\" are ignored with \"-m\"\n\n");
+    if (rank_K > 0) printf("\"--top\" is ignored with \"-m\"\n\n");
+    err = hits_solve_blocked(&g, no_threads, 1, (size_t)mem_mb << 20, fauth,
+                             fhub, NULL) == EXIT_FAILURE;
+    hits_close(&g);
+    if (err) {
+      fprintf(stderr, " [ERROR] HITS result could not be computed.\n");
+      exit(EXIT_FAILURE);
+    }
+    exit(EXIT_SUCCESS);
+  }
+
   /* Setting up data for HITS computation */
-  a = (double *)malloc(sizeof(double) * no_nodes);
-  h = (double *)malloc(sizeof(double) * no_nodes);
-  for (i = 0; i < no_nodes; ++i) {
+  a = (real *)malloc(sizeof(real) * g.no_nodes);
+  h = (real *)malloc(sizeof(real) * g.no_nodes);
+  for (i = 0; i < g.no_nodes; ++i) {
     a[i] = 1.;
     h[i] = 1.;
   }
 
-  compute_hits();
+  /* After an update the previous result is a good first guess, new nodes
+   * start from the average score */
+  if (delta_p[0] != '\0') {
+    for (i = 0; i < g.no_nodes; ++i) {
+      a[i] = 1. / (double)g.no_nodes;
+      h[i] = 1. / (double)g.no_nodes;
+    }
+    if (read_scores(fauth, a, g.no_nodes, g.perm) > 0 &&
+        read_scores(fhub, h, g.no_nodes, g.perm) > 0)
+      printf("Warm start from \"%s\" and \"%s\"\n\n", fauth, fhub);
+    else
+      printf("No previous result, cold start\n\n");
+  }
+
+  if (hits_solve(&g, no_threads, 1, a, h, NULL) == EXIT_FAILURE) {
+    fprintf(stderr, " [ERROR] HITS result could not be computed.\n");
+    hits_close(&g);
+    free(a);
+    free(h);
+    exit(EXIT_FAILURE);
+  }
 
   /* Computing top-K Jaccard coefficients */
-  if (argc > 2) {
-    sscanf(argv[2], "%d", &top_K);
+  err = 0;
+  if (top_K > 0) {
+    if (g.perm != NULL) {
+      ids = (int *)malloc(sizeof(int) * g.no_nodes);
+      for (i = 0; i < g.no_nodes; ++i) ids[g.perm[i]] = i;
+    }
     printf("Computing Jaccard on a\n");
-    compute_jaccard(a, row_ptr_t, col_ind_t, no_nodes, top_K, fname, "a");
+    err = compute_jaccard(a, g.row_ptr_t, g.col_ind_t, g.no_nodes, top_K,
+                          fname, "a", ids, no_threads, jac_text) ==
+          EXIT_FAILURE;
     printf("\nComputing Jaccard on h\n");
-    compute_jaccard(h, row_ptr_t, col_ind_t, no_nodes, top_K, fname, "h");
+    err = compute_jaccard(h, g.row_ptr_t, g.col_ind_t, g.no_nodes, top_K,
+                          fname, "h", ids, no_threads, jac_text) ==
+              EXIT_FAILURE ||
+          err;
+    free(ids);
   }
 
-  /* un-mmapping data */
-  munmap(row_ptr, (no_nodes + 1) * sizeof(int));
-  munmap(row_ptr_t, (no_nodes + 1) * sizeof(int));
-  munmap(col_ind, no_edges * sizeof(int));
-  munmap(col_ind_t, no_edges * sizeof(int));
-
-  /* Writing data back to memory */
-  err = (write_data(fauth, (void *)a, sizeof(double), no_nodes) ==
+  /* Writing data back to memory, even when Jaccard failed: the scores are
+   * valid. The phases of the two vectors get their own names */
+  err = (write_scores(fauth, a, g.no_nodes, g.perm, "output_a") ==
+         EXIT_FAILURE) ||
+        (write_scores(fhub, h, g.no_nodes, g.perm, "output_h") ==
          EXIT_FAILURE) ||
-        (write_data(fhub, (void *)h, sizeof(double), no_nodes) == EXIT_FAILURE);
+        err;
+  if (!err && rank_K > 0) {
+    printf("Writing the top %d nodes to \"%s\" and \"%s\"\n", rank_K,
+           ftop_a, ftop_h);
+    err = write_top_K(ftop_a, ftop_a_csv, a, g.no_nodes, g.perm, rank_K,
+                      no_threads, "top_k_a") == EXIT_FAILURE ||
+          write_top_K(ftop_h, ftop_h_csv, h, g.no_nodes, g.perm, rank_K,
+                      no_threads, "top_k_h") == EXIT_FAILURE;
+  }
+
+  if (ref_dir[0] != '\0') {
+    compare_scores(a, fref_a, g.no_nodes, g.perm, no_threads);
+    compare_scores(h, fref_h, g.no_nodes, g.perm, no_threads);
+  }
+  hits_close(&g);
 
   /* Vectors of probability */
   free(a);
   free(h);
 
-  /* Manage error from writing data to memory */
+  /* Manage error from writing data to memory. write_scores() removes a
+   * file it could not write, the others are left as they are */
   if (err) {
     fprintf(stderr, " [ERROR] HITS result could not be written in memory.\n");
-    if (stat(fauth, &st) == 0) remove(fauth);
-    if (stat(fhub, &st) == 0) remove(fhub);
     exit(EXIT_FAILURE);
   }
 
   exit(EXIT_SUCCESS);
 }
-
-void perform_compression(const char dataset_path[FNAME]) {
-  /* Reading data from input file */
-  FILE *pf;
-  char *s = NULL;
-  size_t slen = 0;
-  ssize_t bytes;
-  int ri, ci;
-  int *from, *to;
-  int f, t;
-  int i;
-  int err;
-
-  printf(
-      "Input file data \"%s\" is not compressed, ready to perform "
-      "compression...\n\n",
-      dataset_path);
-  mkdir(dir, 0700);
-
-  if ((pf = fopen(dataset_path, "r")) == NULL) {
-    fprintf(stderr, " [ERROR] cannot open input file \"%s\"\n", dataset_path);
-    exit(EXIT_FAILURE);
-  }
-
-  /* Parsing input file header */
-  printf("Parsing input data...\n");
-  bytes = getline(&s, &slen, pf);
-  bytes = getline(&s, &slen, pf);
-  bytes = getline(&s, &slen, pf);
-  sscanf(s, "# Nodes: %d Edges: %d", &no_nodes, &no_edges);
-  printf("This graph has %d nodes and %d edges\n", no_nodes, no_edges);
-  bytes = getline(&s, &slen, pf);
-
-  lcsr_data.no_nodes = no_nodes;
-  lcsr_data.no_edges = no_edges;
-
-  /* Reading data from input file */
-  i = 0;
-  from = (int *)malloc(sizeof(int) * no_edges);
-  to = (int *)malloc(sizeof(int) * no_edges);
-  while ((bytes = getline(&s, &slen, pf)) != -1) {
-    sscanf(s, "%d %d", from + i, to + i);
-    if (i % 10 == 0) printf("\rEdge %d/%d", i, no_edges);
-    ++i;
-  }
-  printf("\rEdge %d/%d\n", i, no_edges);
-  printf("Done\n\n");
-  fclose(pf);
-  free(s);
-
-  /* LCSR matrix initialization */
-  col_ind = (int *)malloc(sizeof(int) * no_edges);
-  row_ptr = (int *)malloc(sizeof(int) * (no_nodes + 1));
-  ri = 0;
-  row_ptr[ri] = 0;
-  ci = 0;
-
-  /* Writing data in LCSR matrix */
-  for (ci = 0; ci < no_edges; ++ci) {
-    f = from[ci];
-    t = to[ci];
-    if (f > ri) {
-      for (i = ri + 1; i <= f; ++i) {
-        row_ptr[i] = ci;
-      }
-      ri = f;
-    }
-    col_ind[ci] = t;
-  }
-  while (ri < no_nodes) row_ptr[++ri] = ci;
-
-#ifdef DEBUG
-  printf("LCSR matrix\n");
-  printf("---------------------\n");
-
-  printf("col_ind: [ ");
-  for (i = 0; i < no_edges; ++i) {
-    printf("%d ", col_ind[i]);
-  }
-  printf("]\n");
-
-  printf("row_ptr: [ ");
-  for (i = 0; i < no_nodes + 1; ++i) {
-    printf("%d ", row_ptr[i]);
-  }
-  printf("]\n\n");
-#endif
-
-  printf("Sorting edges for transposed matrix...\n");
-  sort_input_data(from, to, no_edges);
-  printf("Done.\n\n");
-
-  /* Transposed LCSR matrix initialization */
-  col_ind_t = (int *)malloc(sizeof(int) * no_edges);
-  row_ptr_t = (int *)malloc(sizeof(int) * (no_nodes + 1));
-  ri = 0;
-  row_ptr_t[ri] = 0;
-  ci = 0;
-
-  /* Writing data in Transposed LCSR matrix */
-  for (ci = 0; ci < no_edges; ++ci) {
-    f = from[ci];
-    t = to[ci];
-    if (t > ri) {
-      for (i = ri + 1; i <= t; ++i) {
-        row_ptr_t[i] = ci;
-      }
-      ri = t;
-    }
-    col_ind_t[ci] = f;
-  }
-  while (ri < no_nodes) row_ptr_t[++ri] = ci;
-
-#ifdef DEBUG
-  printf("Transposed LCSR matrix\n");
-  printf("---------------------\n");
-
-  printf("col_ind_t: [ ");
-  for (i = 0; i < no_edges; ++i) {
-    printf("%d ", col_ind_t[i]);
-  }
-  printf("]\n");
-
-  printf("row_ptr_t: [ ");
-  for (i = 0; i < no_nodes + 1; ++i) {
-    printf("%d ", row_ptr_t[i]);
-  }
-  printf("]\n\n");
-#endif
-
-  /* Writing data back to memory */
-  err = (write_data(row_ptr_p, (void *)row_ptr, sizeof(int), no_nodes + 1) ==
-         EXIT_FAILURE) ||
-        (write_data(col_ind_p, (void *)col_ind, sizeof(int), no_edges) ==
-         EXIT_FAILURE) ||
-        (write_data(row_ptr_tp, (void *)row_ptr_t, sizeof(int), no_nodes + 1) ==
-         EXIT_FAILURE) ||
-        (write_data(col_ind_tp, (void *)col_ind_t, sizeof(int), no_edges) ==
-         EXIT_FAILURE) ||
-        (write_data(lcsr_data_p, (void *)&lcsr_data, sizeof(LCSR_data), 1) ==
-         EXIT_FAILURE);
-
-  /* Input data */
-  free(from);
-  free(to);
-  from = NULL;
-  to = NULL;
-  /* CSR data structure */
-  free(col_ind);
-  free(row_ptr);
-  free(col_ind_t);
-  free(row_ptr_t);
-  col_ind = NULL;
-  row_ptr = NULL;
-  col_ind_t = NULL;
-  row_ptr_t = NULL;
-
-  /* Manage error from writing data to memory */
-  if (err) {
-    delete_folder(dir);
-    fprintf(stderr, " [ERROR] data could not be written in memory.\n");
-    exit(EXIT_FAILURE);
-  }
-}
-
-void compute_hits(void) {
-  /* HITS computation */
-  double a_dist = DBL_MAX, h_dist = DBL_MAX;
-  double sum;
-  int iter = 0;
-  int ri, ci;
-  int i;
-  double *a_new = (double *)malloc(sizeof(double) * no_nodes);
-  double *h_new = (double *)malloc(sizeof(double) * no_nodes);
-
-  /* Time elapsed data */
-  clock_t begin, end;
-  double elapsed_time;
-
-  /* Computing HITS */
-  printf("Computing HITS...\n");
-  begin = clock();
-  while ((a_dist > TOL || h_dist > TOL) && iter < MAX_ITER) {
-    if (iter % MOD_ITER == 0) {
-      printf("\riter %d", iter);
-#ifdef DEBUG
-      printf("\n");
-      printf("a: ");
-      print_vec_f(a, no_nodes);
-      printf("h: ");
-      print_vec_f(h, no_nodes);
-#endif
-    }
-
-    /* a_new = Lt @ h, h_new = L @ a */
-    for (ri = 0; ri < no_nodes; ++ri) {
-      a_new[ri] = 0.;
-      for (ci = row_ptr_t[ri]; ci < row_ptr_t[ri + 1]; ++ci) {
-        a_new[ri] += h[col_ind_t[ci]];
-      }
-      h_new[ri] = .0;
-      for (ci = row_ptr[ri]; ci < row_ptr[ri + 1]; ++ci) {
-        h_new[ri] += a[col_ind[ci]];
-      }
-    }
-
-    /* Normalization step */
-    sum = 0.;
-    for (i = 0; i < no_nodes; ++i) sum += a_new[i];
-    for (i = 0; i < no_nodes; ++i) a_new[i] /= sum;
-    sum = 0.;
-    for (i = 0; i < no_nodes; ++i) sum += h_new[i];
-    for (i = 0; i < no_nodes; ++i) h_new[i] /= sum;
-
-    /* Computing distance between current and old a/h */
-    a_dist = 0.;
-    h_dist = 0.;
-    for (i = 0; i < no_nodes; ++i) {
-      a_dist += (a[i] - a_new[i]) * (a[i] - a_new[i]);
-      h_dist += (h[i] - h_new[i]) * (h[i] - h_new[i]);
-    }
-    a_dist = sqrt(a_dist);
-    h_dist = sqrt(h_dist);
-
-    /* Copy new values in a/h */
-    for (i = 0; i < no_nodes; ++i) {
-      a[i] = a_new[i];
-      h[i] = h_new[i];
-    }
-
-    ++iter;
-  }
-  end = clock();
-  printf("\riter %d\n", iter);
-#ifdef DEBUG
-  printf("a: ");
-  print_vec_f(a, no_nodes);
-  printf("h: ");
-  print_vec_f(h, no_nodes);
-#endif
-  printf("Done.\n\n");
-
-  printf("Proof of correctness:\n");
-  sum = 0.;
-  for (i = 0; i < no_nodes; ++i) {
-    sum += a[i];
-  }
-  printf("sum(a) = %f\n", sum);
-  sum = 0.;
-  for (i = 0; i < no_nodes; ++i) {
-    sum += h[i];
-  }
-  printf("sum(h) = %f\n\n", sum);
-
-  elapsed_time = (double)(end - begin) / CLOCKS_PER_SEC;
-  printf("Elapsed time: %.3fs\n", elapsed_time);
-
-  free(a_new);
-  free(h_new);
-}
@@ -0,0 +1,770 @@
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "blocks.h"
+#include "irws.h"
+#include "metrics.h"
+
+/* Sections of the cache file */
+#define SEC_ROW_PTR 0
+#define SEC_COL_IND 1
+#define SEC_ROW_PTR_T 2
+#define SEC_COL_IND_T 3
+#define SEC_PERM 4
+#define NO_SECTIONS 5
+
+/* Path of the file name in the cache directory dir */
+static void cache_path(char *path, const char *dir, const char *name) {
+  strcpy(path, dir);
+  strcat(path, name);
+}
+
+/* Writes the cache file of dir: L, L^T and perm, which may be NULL. hdr
+ * holds the source stamp and the sizes */
+static int write_hits_cache(const char *dir, Cache_header *hdr,
+                            const eidx *row_ptr, const int *col_ind,
+                            const eidx *row_ptr_t, const int *col_ind_t,
+                            const int *perm, int no_threads) {
+  char path[DNAME + FNAME];
+  const void *data[NO_SECTIONS];
+
+  hdr->no_sections = NO_SECTIONS;
+  data[SEC_ROW_PTR] = row_ptr;
+  hdr->section[SEC_ROW_PTR].size = sizeof(eidx) * (hdr->no_nodes + 1L);
+  data[SEC_COL_IND] = col_ind;
+  hdr->section[SEC_COL_IND].size = sizeof(int) * hdr->no_edges;
+  data[SEC_ROW_PTR_T] = row_ptr_t;
+  hdr->section[SEC_ROW_PTR_T].size = sizeof(eidx) * (hdr->no_nodes + 1L);
+  data[SEC_COL_IND_T] = col_ind_t;
+  hdr->section[SEC_COL_IND_T].size = sizeof(int) * hdr->no_edges;
+  data[SEC_PERM] = perm;
+  hdr->section[SEC_PERM].size =
+      perm != NULL ? sizeof(int) * (long)hdr->no_nodes : 0;
+  cache_path(path, dir, CACHE_FILE);
+  return write_cache(path, hdr, data, no_threads);
+}
+
+/* Whether the sections of hdr have the sizes its counts give them in a
+ * HITS cache, and both row_ptr and row_ptr_t span no_edges entries */
+static int hits_sections(const Cache_header *hdr) {
+  const Cache_section *s = hdr->section;
+  const char *base = (const char *)hdr;
+  const eidx *row_ptr, *row_ptr_t;
+  long n = hdr->no_nodes;
+
+  if (hdr->no_sections != NO_SECTIONS ||
+      s[SEC_ROW_PTR].size != (long)sizeof(eidx) * (n + 1) ||
+      s[SEC_COL_IND].size != (long)sizeof(int) * hdr->no_edges ||
+      s[SEC_ROW_PTR_T].size != (long)sizeof(eidx) * (n + 1) ||
+      s[SEC_COL_IND_T].size != (long)sizeof(int) * hdr->no_edges ||
+      (s[SEC_PERM].size != 0 && s[SEC_PERM].size != (long)sizeof(int) * n))
+    return 0;
+  row_ptr = (const eidx *)(base + s[SEC_ROW_PTR].offset);
+  row_ptr_t = (const eidx *)(base + s[SEC_ROW_PTR_T].offset);
+  return row_ptr[0] == 0 && row_ptr[n] == hdr->no_edges &&
+         row_ptr_t[0] == 0 && row_ptr_t[n] == hdr->no_edges;
+}
+
+/* Builds the cache of the edge list dataset in dir, replacing whatever
+ * dir held */
+int hits_build(const char *dataset, const char *dir, const char *order,
+               int no_threads, int verbose) {
+  Cache_header hdr;
+  int *from, *to;
+  int *perm = NULL;
+  eidx *row_ptr, *row_ptr_t;
+  int *col_ind, *col_ind_t;
+  int no_nodes;
+  eidx no_edges;
+  int err;
+  Metrics_mark begin, m;
+#ifdef DEBUG
+  eidx i;
+#endif
+
+  if (verbose)
+    printf(
+        "Input file data \"%s\" is not compressed, ready to perform "
+        "compression...\n\n",
+        dataset);
+  metrics_mark(&begin);
+
+  /* Reading data from input file */
+  if (verbose) printf("Parsing input data...\n");
+  if (read_edge_list(dataset, no_threads, &no_nodes, &no_edges, &from, &to) ==
+      EXIT_FAILURE)
+    return EXIT_FAILURE;
+  metrics_phase("parse", &begin);
+  if (verbose) {
+    printf("This graph has %d nodes and %ld edges\n", no_nodes,
+           (long)no_edges);
+    printf("Done\n\n");
+  }
+
+  if (order != NULL && order[0] != '\0') {
+    if (verbose) printf("Reordering nodes (%s)...\n", order);
+    metrics_mark(&m);
+    if ((perm = reorder_nodes(from, to, no_nodes, no_edges, order,
+                              no_threads)) == NULL) {
+      free(from);
+      free(to);
+      return EXIT_FAILURE;
+    }
+    metrics_phase("reorder", &m);
+    if (verbose) printf("Done.\n\n");
+  }
+  if (access(dir, F_OK) == 0) delete_folder(dir);
+  mkdir(dir, 0700);
+
+  init_cache_header(&hdr, dataset);
+  hdr.no_nodes = no_nodes;
+  hdr.no_edges = no_edges;
+
+  /* LCSR matrix initialization */
+  metrics_mark(&m);
+  col_ind = (int *)malloc(sizeof(int) * (size_t)no_edges);
+  row_ptr = (eidx *)malloc(sizeof(eidx) * (no_nodes + 1));
+
+  /* Writing data in LCSR matrix */
+  build_csr(from, to, no_nodes, no_edges, 0, no_threads, row_ptr, col_ind);
+  metrics_phase("csr", &m);
+
+#ifdef DEBUG
+  printf("LCSR matrix\n");
+  printf("---------------------\n");
+
+  printf("col_ind: [ ");
+  for (i = 0; i < no_edges; ++i) {
+    printf("%d ", col_ind[i]);
+  }
+  printf("]\n");
+
+  printf("row_ptr: [ ");
+  for (i = 0; i < no_nodes + 1; ++i) {
+    printf("%ld ", (long)row_ptr[i]);
+  }
+  printf("]\n\n");
+#endif
+
+  /* Transposed LCSR matrix initialization */
+  col_ind_t = (int *)malloc(sizeof(int) * (size_t)no_edges);
+  row_ptr_t = (eidx *)malloc(sizeof(eidx) * (no_nodes + 1));
+
+  /* Writing data in Transposed LCSR matrix. Jaccard merges the in-link
+   * lists, so they must be sorted */
+  if (verbose) printf("Building transposed matrix...\n");
+  metrics_mark(&m);
+  build_csr(to, from, no_nodes, no_edges, 1, no_threads, row_ptr_t, col_ind_t);
+  metrics_phase("sort", &m);
+  if (verbose) printf("Done.\n\n");
+
+#ifdef DEBUG
+  printf("Transposed LCSR matrix\n");
+  printf("---------------------\n");
+
+  printf("col_ind_t: [ ");
+  for (i = 0; i < no_edges; ++i) {
+    printf("%d ", col_ind_t[i]);
+  }
+  printf("]\n");
+
+  printf("row_ptr_t: [ ");
+  for (i = 0; i < no_nodes + 1; ++i) {
+    printf("%ld ", (long)row_ptr_t[i]);
+  }
+  printf("]\n\n");
+#endif
+
+  /* Writing data back to memory */
+  metrics_mark(&m);
+  err = write_hits_cache(dir, &hdr, row_ptr, col_ind, row_ptr_t, col_ind_t,
+                         perm, no_threads) == EXIT_FAILURE;
+  metrics_phase("write", &m);
+
+  free(from);
+  free(to);
+  free(perm);
+  free(col_ind);
+  free(row_ptr);
+  free(col_ind_t);
+  free(row_ptr_t);
+
+  /* Manage error from writing data to memory */
+  if (err) {
+    delete_folder(dir);
+    fprintf(stderr, " [ERROR] Data could not be written in memory.\n");
+    return EXIT_FAILURE;
+  }
+  metrics_phase("build", &begin);
+  return EXIT_SUCCESS;
+}
+
+/* Merges the edge delta in delta into the cache: L and L^T are rebuilt row
+ * by row from the old ones, L^T staying sorted. The compressed copies are
+ * removed, they are rebuilt the next time they are opened */
+int hits_update(const char *dir, const char *delta, int no_threads,
+                int verbose) {
+  char path[DNAME + FNAME];
+  HITS_graph g;
+  Cache_header hdr;
+  int *ins_from, *ins_to, *del_from, *del_to;
+  int no_ins, no_del;
+  eidx *new_ptr, *new_ptr_t;
+  int *new_ind, *new_ind_t, *new_perm = NULL;
+  int new_nodes;
+  int i;
+  unsigned long stamp;
+  int err;
+
+  /* Time elapsed data */
+  Metrics_mark begin;
+  double elapsed_time;
+
+  if (verbose) printf("Updating \"%s\" with \"%s\"...\n", dir, delta);
+  metrics_mark(&begin);
+
+  if (hits_open(&g, dir, IRWS_VERIFY | IRWS_SEQUENTIAL, no_threads) ==
+      EXIT_FAILURE)
+    return EXIT_FAILURE;
+
+  /* A delta merged twice would duplicate its edges */
+  stamp = file_stamp(delta, no_threads);
+  if (delta_applied(g.hdr, stamp)) {
+    fprintf(stderr, " [ERROR] \"%s\" was already merged into \"%s\"\n",
+            delta, dir);
+    hits_close(&g);
+    return EXIT_FAILURE;
+  }
+
+  new_nodes = g.no_nodes;
+  if (read_edge_delta(delta, g.perm, &new_nodes, &no_ins, &ins_from, &ins_to,
+                      &no_del, &del_from, &del_to) == EXIT_FAILURE) {
+    hits_close(&g);
+    return EXIT_FAILURE;
+  }
+
+  /* The cache keeps the stamp of the input file it was built from, and
+   * records the delta */
+  init_cache_header(&hdr, NULL);
+  hdr.src_size = g.hdr->src_size;
+  hdr.src_mtime = g.hdr->src_mtime;
+  record_delta(&hdr, g.hdr, stamp);
+  hdr.no_nodes = new_nodes;
+  hdr.no_edges =
+      merge_csr(g.row_ptr, g.col_ind, g.no_nodes, new_nodes, ins_from, ins_to,
+                no_ins, del_from, del_to, &no_del, 0, no_threads, &new_ptr,
+                &new_ind);
+  merge_csr(g.row_ptr_t, g.col_ind_t, g.no_nodes, new_nodes, ins_to, ins_from,
+            no_ins, del_to, del_from, &no_del, 1, no_threads, &new_ptr_t,
+            &new_ind_t);
+  if (verbose)
+    printf("%d edges inserted, %d deleted, %d new nodes\n", no_ins, no_del,
+           new_nodes - g.no_nodes);
+
+  /* New nodes keep their ids */
+  if (g.perm != NULL) {
+    new_perm = (int *)malloc(sizeof(int) * new_nodes);
+    memcpy(new_perm, g.perm, sizeof(int) * g.no_nodes);
+    for (i = g.no_nodes; i < new_nodes; ++i) new_perm[i] = i;
+  }
+  hits_close(&g);
+
+  cache_path(path, dir, "row_off.bin");
+  remove(path);
+  cache_path(path, dir, "col_ind.vb");
+  remove(path);
+  cache_path(path, dir, "row_off_t.bin");
+  remove(path);
+  cache_path(path, dir, "col_ind_t.vb");
+  remove(path);
+  cache_path(path, dir, "blocks.bin");
+  remove(path);
+  cache_path(path, dir, "blocks_t.bin");
+  remove(path);
+  cache_path(path, dir, "tiles.bin");
+  remove(path);
+  cache_path(path, dir, "tiles_t.bin");
+  remove(path);
+  err = write_hits_cache(dir, &hdr, new_ptr, new_ind, new_ptr_t, new_ind_t,
+                         new_perm, no_threads) == EXIT_FAILURE;
+
+  free(ins_from);
+  free(ins_to);
+  free(del_from);
+  free(del_to);
+  free(new_ptr);
+  free(new_ind);
+  free(new_ptr_t);
+  free(new_ind_t);
+  free(new_perm);
+
+  /* write_cache() leaves the previous cache in place when it fails, so it
+   * is still valid, only the delta is not merged */
+  if (err) {
+    fprintf(stderr, " [ERROR] \"%s\" could not be merged into \"%s\"\n",
+            delta, dir);
+    return EXIT_FAILURE;
+  }
+
+  elapsed_time = metrics_phase("update", &begin);
+  if (verbose) printf("Done.\nElapsed time: %.3fs\n\n", elapsed_time);
+  return EXIT_SUCCESS;
+}
+
+/* Maps the cache file of dir into g, with the IRWS_* flags. With
+ * IRWS_COMPRESSED, the compressed col_ind/col_ind_t are built if needed
+ * and mapped as well */
+int hits_open(HITS_graph *g, const char *dir, int flags, int no_threads) {
+  char path[DNAME + FNAME], path_vb[DNAME + FNAME];
+  const char *base;
+  int map_flags = 0;
+  int err;
+  Metrics_mark begin;
+
+  metrics_mark(&begin);
+  memset(g, 0, sizeof(HITS_graph));
+  strncpy(g->dir, dir, DNAME - 1);
+
+  if (flags & IRWS_POPULATE) map_flags |= CACHE_POPULATE;
+  if (flags & IRWS_VERIFY) map_flags |= CACHE_VERIFY;
+  if (flags & IRWS_SEQUENTIAL) map_flags |= CACHE_SEQUENTIAL;
+  cache_path(path, dir, CACHE_FILE);
+  if ((g->hdr = map_cache(path, map_flags, no_threads, &g->map_len)) ==
+      NULL)
+    return EXIT_FAILURE;
+  if (!hits_sections(g->hdr)) {
+    fprintf(stderr, " [ERROR] \"%s\" is not a HITS cache\n", path);
+    hits_close(g);
+    return EXIT_FAILURE;
+  }
+  g->no_nodes = g->hdr->no_nodes;
+  g->no_edges = g->hdr->no_edges;
+
+  base = (const char *)g->hdr;
+  g->row_ptr = (eidx *)(base + g->hdr->section[SEC_ROW_PTR].offset);
+  g->col_ind = (int *)(base + g->hdr->section[SEC_COL_IND].offset);
+  g->row_ptr_t = (eidx *)(base + g->hdr->section[SEC_ROW_PTR_T].offset);
+  g->col_ind_t = (int *)(base + g->hdr->section[SEC_COL_IND_T].offset);
+  if (g->hdr->section[SEC_PERM].size > 0)
+    g->perm = (int *)(base + g->hdr->section[SEC_PERM].offset);
+
+  if (flags & IRWS_COMPRESSED) {
+    cache_path(path, dir, "row_off.bin");
+    cache_path(path_vb, dir, "col_ind.vb");
+    err = load_vb_csr(path, path_vb, g->row_ptr, g->col_ind, g->no_nodes,
+                      cache_stamp(g->hdr), &g->row_off,
+                      &g->col_vb) == EXIT_FAILURE;
+    cache_path(path, dir, "row_off_t.bin");
+    cache_path(path_vb, dir, "col_ind_t.vb");
+    err = err || load_vb_csr(path, path_vb, g->row_ptr_t, g->col_ind_t,
+                             g->no_nodes, cache_stamp(g->hdr), &g->row_off_t,
+                             &g->col_vb_t) == EXIT_FAILURE;
+    if (err) {
+      fprintf(stderr, " [ERROR] Data could not be mmapped from memory.\n");
+      hits_close(g);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (flags & IRWS_TILED) {
+    cache_path(path, dir, "tiles.bin");
+    err = load_tiles(path, g->hdr, g->row_ptr, g->col_ind, map_flags,
+                     no_threads, &g->tiles) == EXIT_FAILURE;
+    cache_path(path, dir, "tiles_t.bin");
+    err = err || load_tiles(path, g->hdr, g->row_ptr_t, g->col_ind_t,
+                            map_flags, no_threads,
+                            &g->tiles_t) == EXIT_FAILURE;
+    if (err) {
+      fprintf(stderr, " [ERROR] Data could not be mmapped from memory.\n");
+      hits_close(g);
+      return EXIT_FAILURE;
+    }
+  }
+  metrics_phase("mmap", &begin);
+  return EXIT_SUCCESS;
+}
+
+void hits_close(HITS_graph *g) {
+  close_tiles(&g->tiles);
+  close_tiles(&g->tiles_t);
+  if (g->row_off != NULL) {
+    if (g->col_vb != NULL) munmap(g->col_vb, g->row_off[g->no_nodes]);
+    munmap(g->row_off, (g->no_nodes + 1) * sizeof(long));
+  }
+  if (g->row_off_t != NULL) {
+    if (g->col_vb_t != NULL) munmap(g->col_vb_t, g->row_off_t[g->no_nodes]);
+    munmap(g->row_off_t, (g->no_nodes + 1) * sizeof(long));
+  }
+  if (g->hdr != NULL) munmap((void *)g->hdr, g->map_len);
+  memset(g, 0, sizeof(HITS_graph));
+}
+
+/* Solves HITS on g, starting from a/h and leaving the normalized results in
+ * them. The number of iterations goes to *iter when iter is not NULL */
+int hits_solve(const HITS_graph *g, int no_threads, int verbose, real *a,
+               real *h, int *iter) {
+  double a_dist = DBL_MAX, h_dist = DBL_MAX;
+  double a_sum, h_sum;
+  double sum;
+  real *cur_a = a, *cur_h = h;
+  real *tmp;
+  int *bounds_a, *bounds_h;
+  int no_nodes = g->no_nodes;
+  int compressed = g->row_off != NULL;
+  int tiled = g->tiles.hdr != NULL;
+  eidx *cuts_a = NULL, *cuts_h = NULL;
+  double *prod_a = NULL, *prod_h = NULL;
+  int no_iter = 0;
+  int i, t;
+  real *a_new = (real *)malloc(sizeof(real) * no_nodes);
+  real *h_new = (real *)malloc(sizeof(real) * no_nodes);
+
+  /* Time elapsed data, and the bytes the two products of an iteration
+   * move */
+  Metrics_mark begin, it;
+  double elapsed_time;
+  double bytes = 2. * spmv_bytes(no_nodes, g->no_edges);
+
+  if (no_threads < 1) no_threads = 1;
+
+  /* a is computed from L^T and h from L, so each product gets its own
+   * edge-balanced split of the rows */
+  bounds_a = (int *)malloc(sizeof(int) * (no_threads + 1));
+  bounds_h = (int *)malloc(sizeof(int) * (no_threads + 1));
+  partition_rows(g->row_ptr_t, no_nodes, no_threads, bounds_a);
+  partition_rows(g->row_ptr, no_nodes, no_threads, bounds_h);
+
+  /* With the tiles, every thread computes the products of its rows tile
+   * after tile first */
+  if (tiled) {
+    cuts_a = tile_cuts(&g->tiles_t, bounds_a, no_threads, no_threads);
+    cuts_h = tile_cuts(&g->tiles, bounds_h, no_threads, no_threads);
+    prod_a = (double *)malloc(sizeof(double) * no_nodes);
+    prod_h = (double *)malloc(sizeof(double) * no_nodes);
+  }
+
+  /* Computing HITS */
+  if (verbose) printf("Computing HITS with %d thread(s)...\n", no_threads);
+  metrics_mark(&begin);
+  while ((a_dist > TOL || h_dist > TOL) && no_iter < MAX_ITER) {
+    metrics_mark(&it);
+    if (verbose && no_iter % MOD_ITER == 0) {
+      printf("\riter %d", no_iter);
+#ifdef DEBUG
+      printf("\n");
+      printf("a: ");
+      print_vec_f(cur_a, no_nodes);
+      printf("h: ");
+      print_vec_f(cur_h, no_nodes);
+#endif
+    }
+
+    /* a_new = Lt @ h, h_new = L @ a, accumulating the sums on the way */
+    a_sum = 0.;
+    h_sum = 0.;
+#pragma omp parallel for schedule(static, 1) reduction(+ : a_sum, h_sum) \
+    num_threads(no_threads)
+    for (t = 0; t < no_threads; ++t) {
+      eidx ci;
+      int ri, col, gap;
+      const unsigned char *s;
+      double acc;
+
+      if (tiled) {
+        for (ri = bounds_a[t]; ri < bounds_a[t + 1]; ++ri) prod_a[ri] = 0.;
+        tile_product(&g->tiles_t, cuts_a, no_threads, t, cur_h, prod_a);
+        for (ri = bounds_h[t]; ri < bounds_h[t + 1]; ++ri) prod_h[ri] = 0.;
+        tile_product(&g->tiles, cuts_h, no_threads, t, cur_a, prod_h);
+      }
+      for (ri = bounds_a[t]; ri < bounds_a[t + 1]; ++ri) {
+        acc = 0.;
+        if (tiled) {
+          acc = prod_a[ri];
+        } else if (compressed) {
+          s = g->col_vb_t + g->row_off_t[ri];
+          col = 0;
+          for (ci = g->row_ptr_t[ri]; ci < g->row_ptr_t[ri + 1]; ++ci) {
+            VB_NEXT(s, gap);
+            col += gap;
+            acc += cur_h[col];
+          }
+        } else {
+          for (ci = g->row_ptr_t[ri]; ci < g->row_ptr_t[ri + 1]; ++ci) {
+            acc += cur_h[g->col_ind_t[ci]];
+          }
+        }
+        a_new[ri] = acc;
+        a_sum += acc;
+      }
+      for (ri = bounds_h[t]; ri < bounds_h[t + 1]; ++ri) {
+        acc = 0.;
+        if (tiled) {
+          acc = prod_h[ri];
+        } else if (compressed) {
+          s = g->col_vb + g->row_off[ri];
+          col = 0;
+          for (ci = g->row_ptr[ri]; ci < g->row_ptr[ri + 1]; ++ci) {
+            VB_NEXT(s, gap);
+            col += gap;
+            acc += cur_a[col];
+          }
+        } else {
+          for (ci = g->row_ptr[ri]; ci < g->row_ptr[ri + 1]; ++ci) {
+            acc += cur_a[g->col_ind[ci]];
+          }
+        }
+        h_new[ri] = acc;
+        h_sum += acc;
+      }
+    }
+
+    /* Normalization step, fused with the distance between old and new a/h */
+    a_dist = 0.;
+    h_dist = 0.;
+#pragma omp parallel for reduction(+ : a_dist, h_dist) num_threads(no_threads)
+    for (i = 0; i < no_nodes; ++i) {
+      double da, dh;
+      a_new[i] /= a_sum;
+      h_new[i] /= h_sum;
+      da = (double)cur_a[i] - a_new[i];
+      dh = (double)cur_h[i] - h_new[i];
+      a_dist += da * da;
+      h_dist += dh * dh;
+    }
+    a_dist = sqrt(a_dist);
+    h_dist = sqrt(h_dist);
+
+    /* New values become the current a/h */
+    tmp = cur_a;
+    cur_a = a_new;
+    a_new = tmp;
+    tmp = cur_h;
+    cur_h = h_new;
+    h_new = tmp;
+
+    metrics_iter("hits", no_iter, &it, 2. * (double)g->no_edges, bytes);
+    ++no_iter;
+  }
+  elapsed_time = metrics_phase("solve", &begin);
+
+  /* The results must end up in the caller's vectors */
+  if (cur_a != a) {
+    memcpy(a, cur_a, sizeof(real) * no_nodes);
+    memcpy(h, cur_h, sizeof(real) * no_nodes);
+    a_new = cur_a;
+    h_new = cur_h;
+  }
+  if (iter != NULL) *iter = no_iter;
+
+  if (verbose) {
+    printf("\riter %d\n", no_iter);
+#ifdef DEBUG
+    printf("a: ");
+    print_vec_f(a, no_nodes);
+    printf("h: ");
+    print_vec_f(h, no_nodes);
+#endif
+    printf("Done.\n\n");
+
+    printf("Proof of correctness:\n");
+    sum = 0.;
+    for (i = 0; i < no_nodes; ++i) {
+      sum += a[i];
+    }
+    printf("sum(a) = %f\n", sum);
+    sum = 0.;
+    for (i = 0; i < no_nodes; ++i) {
+      sum += h[i];
+    }
+    printf("sum(h) = %f\n\n", sum);
+
+    printf("Elapsed time: %.3fs\n", elapsed_time);
+  }
+
+  free(bounds_a);
+  free(bounds_h);
+  free(cuts_a);
+  free(cuts_h);
+  free(prod_a);
+  free(prod_h);
+  free(a_new);
+  free(h_new);
+  return EXIT_SUCCESS;
+}
+
+/* y = M @ x out of core, M being the blocks of bf, one row interval at a
+ * time; x and y are vector files and xs, ys, acc work buffers of one
+ * interval. Returns the sum of y, or -1 on error */
+static double blocked_product(Block_file *bf, int fd_x, int fd_y, real *xs,
+                              real *ys, double *acc, int no_threads) {
+  int P = bf->hdr.no_intervals, interval = bf->hdr.interval;
+  double sum = 0.;
+  int i, j, k, len;
+
+  for (i = 0; i < P; ++i) {
+    len = block_len(bf, i);
+    memset(acc, 0, sizeof(double) * len);
+    for (j = 0; j < P; ++j) {
+      if (bf->count[(long)i * P + j] == 0) continue;
+      if (read_slice(fd_x, xs, (long)j * interval, block_len(bf, j)) ==
+              EXIT_FAILURE ||
+          block_gather(bf, i, j, xs, acc, no_threads) == EXIT_FAILURE)
+        return -1.;
+    }
+    for (k = 0; k < len; ++k) {
+      ys[k] = acc[k];
+      sum += acc[k];
+    }
+    if (write_slice(fd_y, ys, (long)i * interval, len) == EXIT_FAILURE)
+      return -1.;
+  }
+  return sum;
+}
+
+/* Divides the vector file y by sum, and returns its distance from the
+ * vector file x, or -1 on error */
+static double blocked_normalize(const Block_file *bf, int fd_x, int fd_y,
+                                double sum, real *xs, real *ys) {
+  int interval = bf->hdr.interval;
+  double dist = 0., diff;
+  int i, k, len;
+
+  for (i = 0; i < bf->hdr.no_intervals; ++i) {
+    len = block_len(bf, i);
+    if (read_slice(fd_x, xs, (long)i * interval, len) == EXIT_FAILURE ||
+        read_slice(fd_y, ys, (long)i * interval, len) == EXIT_FAILURE)
+      return -1.;
+    for (k = 0; k < len; ++k) {
+      ys[k] /= sum;
+      diff = (double)xs[k] - ys[k];
+      dist += diff * diff;
+    }
+    if (write_slice(fd_y, ys, (long)i * interval, len) == EXIT_FAILURE)
+      return -1.;
+  }
+  return sqrt(dist);
+}
+
+/* HITS out of core, for graphs that do not fit in memory: L^T and L are
+ * streamed from their blocks (blocks_t.bin and blocks.bin, written on the
+ * first call) and a, h and their next values live in files of the cache
+ * directory, of which only one interval at a time is in memory. The
+ * intervals are sized so that about mem bytes are used. The results are
+ * written to a_path and h_path as by write_scores() */
+int hits_solve_blocked(const HITS_graph *g, int no_threads, int verbose,
+                       size_t mem, const char *a_path, const char *h_path,
+                       int *iter) {
+  static const char *vec_names[4] = {"a.vec", "a_new.vec", "h.vec",
+                                     "h_new.vec"};
+  char path[DNAME + FNAME], vec_p[4][DNAME + FNAME];
+  Block_file bt, bl;
+  /* a, a_new, h, h_new */
+  int fd[4] = {-1, -1, -1, -1};
+  int tmp;
+  double a_dist = DBL_MAX, h_dist = DBL_MAX;
+  double a_sum = 0., h_sum = 0.;
+  double *acc;
+  real *xs, *ys;
+  int interval;
+  int no_iter = 0;
+  int k;
+  int err = 0;
+
+  /* Time elapsed data */
+  Metrics_mark begin, it;
+  double elapsed_time;
+
+  if (no_threads < 1) no_threads = 1;
+
+  interval = block_interval(g->no_nodes, mem,
+                            sizeof(double) + 2 * sizeof(real), 2);
+  if (interval == 0) {
+    fprintf(stderr, " [ERROR] A memory budget of %lu bytes is too small\n",
+            (unsigned long)mem);
+    return EXIT_FAILURE;
+  }
+  cache_path(path, g->dir, "blocks_t.bin");
+  if (open_blocks(&bt, path, g->row_ptr_t, g->col_ind_t, g->no_nodes,
+                  interval, cache_stamp(g->hdr)) == EXIT_FAILURE)
+    return EXIT_FAILURE;
+  cache_path(path, g->dir, "blocks.bin");
+  if (open_blocks(&bl, path, g->row_ptr, g->col_ind, g->no_nodes,
+                  interval, cache_stamp(g->hdr)) == EXIT_FAILURE) {
+    close_blocks(&bt);
+    return EXIT_FAILURE;
+  }
+  acc = (double *)malloc(sizeof(double) * interval);
+  xs = (real *)malloc(sizeof(real) * interval);
+  ys = (real *)malloc(sizeof(real) * interval);
+
+  for (k = 0; k < 4 && !err; ++k) {
+    cache_path(vec_p[k], g->dir, vec_names[k]);
+    err = (fd[k] = create_vector(vec_p[k], &bt, 1., xs)) == -1;
+  }
+
+  if (verbose)
+    printf("Computing HITS out of core (%d intervals of %d nodes) with %d "
+           "thread(s)...\n",
+           bt.hdr.no_intervals, interval, no_threads);
+  metrics_mark(&begin);
+  while (!err && (a_dist > TOL || h_dist > TOL) && no_iter < MAX_ITER) {
+    if (verbose && no_iter % MOD_ITER == 0) printf("\riter %d", no_iter);
+    metrics_mark(&it);
+
+    /* a_new = Lt @ h, h_new = L @ a, then both are normalized */
+    a_sum = blocked_product(&bt, fd[2], fd[1], xs, ys, acc, no_threads);
+    h_sum = blocked_product(&bl, fd[0], fd[3], xs, ys, acc, no_threads);
+    err = a_sum < 0. || h_sum < 0.;
+    if (!err) {
+      a_dist = blocked_normalize(&bt, fd[0], fd[1], a_sum, xs, ys);
+      h_dist = blocked_normalize(&bt, fd[2], fd[3], h_sum, xs, ys);
+      err = a_dist < 0. || h_dist < 0.;
+    }
+
+    /* New values become the current a/h */
+    tmp = fd[0];
+    fd[0] = fd[1];
+    fd[1] = tmp;
+    tmp = fd[2];
+    fd[2] = fd[3];
+    fd[3] = tmp;
+    metrics_iter("hits", no_iter, &it, 2. * (double)g->no_edges,
+                 2. * spmv_bytes(g->no_nodes, g->no_edges));
+    ++no_iter;
+  }
+  elapsed_time = metrics_phase("solve", &begin);
+
+  if (err)
+    fprintf(stderr, " [ERROR] Out-of-core HITS could not be computed\n");
+  else
+    err = save_vector(fd[0], g->no_nodes, g->perm, a_path, "output_a") ==
+              EXIT_FAILURE ||
+          save_vector(fd[2], g->no_nodes, g->perm, h_path, "output_h") ==
+              EXIT_FAILURE;
+  if (iter != NULL) *iter = no_iter;
+
+  if (!err && verbose) {
+    printf("\riter %d\n", no_iter);
+    printf("Done.\n\n");
+    printf("Elapsed time: %.3fs\n", elapsed_time);
+  }
+
+  for (k = 0; k < 4; ++k) {
+    if (fd[k] == -1) continue;
+    close(fd[k]);
+    remove(vec_p[k]);
+  }
+  close_blocks(&bt);
+  close_blocks(&bl);
+  free(acc);
+  free(xs);
+  free(ys);
+  return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
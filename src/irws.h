@@ -0,0 +1,91 @@
+#ifndef IRWS_H
+#define IRWS_H
+
+#include "tiles.h"
+#include "utils.h"
+
+/* libirws: the PageRank and HITS engines behind an explicit graph handle.
+ * Nothing is kept in globals, so several graphs can be opened and solved
+ * concurrently in one process; only the metrics recorder of metrics.h is
+ * process-wide, and off unless opened. Functions return EXIT_SUCCESS or
+ * EXIT_FAILURE, errors are reported on stderr and progress on stdout when
+ * verbose is set. Cache directories end with '/' */
+
+/* pr_open()/hits_open() flags */
+#define IRWS_COMPRESSED 1 /* also map the compressed col_ind */
+#define IRWS_POPULATE 2   /* read every page of the cache in up front */
+#define IRWS_VERIFY 4     /* check every section against its checksum */
+#define IRWS_SEQUENTIAL 8 /* the cache is read once, in order */
+#define IRWS_TILED 16     /* also map the tiled col_ind */
+
+/* PageRank cache (PR_<name>/): the transposed matrix AT, whose row t holds
+ * the sources of the edges pointing to t */
+typedef struct {
+  char dir[DNAME];
+  /* The cache file, mapped at once, and its length */
+  const Cache_header *hdr;
+  size_t map_len;
+  int no_nodes, no_danglings;
+  eidx no_edges;
+  eidx *row_ptr;
+  int *col_ind;
+  double *inv_out_deg;
+  int *danglings;
+  /* Input ids to cache ids, NULL if the nodes were not reordered */
+  int *perm;
+  /* Compressed col_ind, used by the solvers when row_off is set */
+  long *row_off;
+  unsigned char *col_vb;
+  /* Tiled col_ind, used by the power iterations when tiles.hdr is set */
+  Tile_csr tiles;
+} PR_graph;
+
+/* solver is "jacobi", "gs", "extrap", "bicgstab" or "adaptive". With
+ * numa set, pr_solve() binds the threads to the NUMA nodes and places the
+ * rows they own, and their part of the vectors, on their node (the library
+ * must be built with -DNUMA and linked with -lnuma) */
+typedef struct {
+  const char *solver;
+  int no_threads;
+  int verbose;
+  int numa;
+} PR_options;
+
+int pr_build(const char *dataset, const char *dir, const char *order,
+             int no_threads, int verbose);
+int pr_update(const char *dir, const char *delta, int no_threads,
+              int verbose);
+int pr_open(PR_graph *g, const char *dir, int flags, int no_threads);
+int pr_solve(const PR_graph *g, const PR_options *opt, real *p, int *iter);
+int pr_solve_blocked(const PR_graph *g, const PR_options *opt, size_t mem,
+                     const char *out_path, int *iter);
+void pr_close(PR_graph *g);
+
+/* HITS cache (HITS_<name>/): L and L^T, the rows of L^T being sorted */
+typedef struct {
+  char dir[DNAME];
+  const Cache_header *hdr;
+  size_t map_len;
+  int no_nodes;
+  eidx no_edges;
+  eidx *row_ptr, *row_ptr_t;
+  int *col_ind, *col_ind_t;
+  int *perm;
+  long *row_off, *row_off_t;
+  unsigned char *col_vb, *col_vb_t;
+  Tile_csr tiles, tiles_t;
+} HITS_graph;
+
+int hits_build(const char *dataset, const char *dir, const char *order,
+               int no_threads, int verbose);
+int hits_update(const char *dir, const char *delta, int no_threads,
+                int verbose);
+int hits_open(HITS_graph *g, const char *dir, int flags, int no_threads);
+int hits_solve(const HITS_graph *g, int no_threads, int verbose, real *a,
+               real *h, int *iter);
+int hits_solve_blocked(const HITS_graph *g, int no_threads, int verbose,
+                       size_t mem, const char *a_path, const char *h_path,
+                       int *iter);
+void hits_close(HITS_graph *g);
+
+#endif
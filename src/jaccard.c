@@ -1,96 +1,312 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "jaccard.h"
+#include "metrics.h"
 #include "utils.h"
 
-void compute_jaccard(const double *v, const int *row_ptr_t, const int *col_ind_t, int no_nodes,
-                     int top_K, const char *fname, const char *method) {
+/* A row is galloped through rather than merged when it is at least
+ * GALLOP_RATIO times longer than the other one */
+#define GALLOP_RATIO 32
+
+/* Rows of the top-K nodes that hold at least no_nodes / BITMAP_RATIO
+ * in-links, and at least BITMAP_MIN, are also kept as bitmaps, which are
+ * then no larger than the rows */
+#define BITMAP_RATIO 32
+#define BITMAP_MIN 4096
+
+/* An in-link row of L^T. distinct is set when the row has no repeated
+ * entry (no multi-edge), which the vector and bitmap intersections need */
+typedef struct {
+  const int *col;
+  eidx len;
+  int distinct;
+  const unsigned long *bits;
+} Jac_row;
+
+/* Number of common entries of two sorted rows, counted with their
+ * multiplicities, by a plain merge */
+static eidx merge_count(const int *a, eidx na, const int *b, eidx nb) {
+  eidx i = 0, j = 0, n = 0;
+
+  while (i < na && j < nb) {
+    if (a[i] < b[j]) {
+      ++i;
+    } else if (a[i] > b[j]) {
+      ++j;
+    } else {
+      ++n;
+      ++i;
+      ++j;
+    }
+  }
+  return n;
+}
+
+/* Same as merge_count() for na much smaller than nb: every entry of a is
+ * looked up in what is left of b by an exponential then a binary search */
+static eidx gallop_count(const int *a, eidx na, const int *b, eidx nb) {
+  eidx i, j = 0, lo, hi, step, mid, n = 0;
+
+  for (i = 0; i < na && j < nb; ++i) {
+    /* First entry of b from j on that is not below a[i] */
+    step = 1;
+    lo = j;
+    hi = j;
+    while (hi < nb && b[hi] < a[i]) {
+      lo = hi + 1;
+      hi += step;
+      step *= 2;
+    }
+    if (hi > nb) hi = nb;
+    while (lo < hi) {
+      mid = lo + (hi - lo) / 2;
+      if (b[mid] < a[i])
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    j = lo;
+    if (j < nb && b[j] == a[i]) {
+      ++n;
+      ++j;
+    }
+  }
+  return n;
+}
+
+/* Same as merge_count() for rows without repeated entries, comparing
+ * blocks of entries of a against all the rotations of blocks of b, and
+ * advancing the block with the smaller last entry (both if they are equal).
+ * The rest is merged */
+static eidx vector_count(const int *a, eidx na, const int *b, eidx nb) {
+  eidx i = 0, j = 0, n = 0;
+#if defined(__AVX2__)
+  const __m256i rot = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+  __m256i va, vb, eq;
+  int k, last;
+
+  while (i + 8 <= na && j + 8 <= nb) {
+    va = _mm256_loadu_si256((const __m256i *)(a + i));
+    vb = _mm256_loadu_si256((const __m256i *)(b + j));
+    eq = _mm256_cmpeq_epi32(va, vb);
+    for (k = 1; k < 8; ++k) {
+      vb = _mm256_permutevar8x32_epi32(vb, rot);
+      eq = _mm256_or_si256(eq, _mm256_cmpeq_epi32(va, vb));
+    }
+    n += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(eq)));
+    last = a[i + 7];
+    if (last <= b[j + 7]) i += 8;
+    if (last >= b[j + 7]) j += 8;
+  }
+#elif defined(__SSE2__)
+  __m128i va, vb, eq;
+  int last;
+
+  while (i + 4 <= na && j + 4 <= nb) {
+    va = _mm_loadu_si128((const __m128i *)(a + i));
+    vb = _mm_loadu_si128((const __m128i *)(b + j));
+    eq = _mm_cmpeq_epi32(va, vb);
+    vb = _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1));
+    eq = _mm_or_si128(eq, _mm_cmpeq_epi32(va, vb));
+    vb = _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1));
+    eq = _mm_or_si128(eq, _mm_cmpeq_epi32(va, vb));
+    vb = _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1));
+    eq = _mm_or_si128(eq, _mm_cmpeq_epi32(va, vb));
+    n += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(eq)));
+    last = a[i + 3];
+    if (last <= b[j + 3]) i += 4;
+    if (last >= b[j + 3]) j += 4;
+  }
+#endif
+  return n + merge_count(a + i, na - i, b + j, nb - j);
+}
+
+/* Same as merge_count() for rows without repeated entries, b being a
+ * bitmap */
+static eidx bitmap_count(const int *a, eidx na, const unsigned long *b) {
+  eidx i, n = 0;
+
+  for (i = 0; i < na; ++i) n += (b[a[i] / 64] >> (a[i] % 64)) & 1;
+  return n;
+}
+
+/* Size of the intersection of two rows, with the cheapest method for
+ * their lengths and forms */
+static eidx intersect(const Jac_row *x, const Jac_row *y) {
+  const Jac_row *tmp;
+
+  if (x->len > y->len) {
+    tmp = x;
+    x = y;
+    y = tmp;
+  }
+  if (x->len == 0) return 0;
+  if (y->bits != NULL && x->distinct)
+    return bitmap_count(x->col, x->len, y->bits);
+  if (y->len >= GALLOP_RATIO * x->len)
+    return gallop_count(x->col, x->len, y->col, y->len);
+  if (x->distinct && y->distinct)
+    return vector_count(x->col, x->len, y->col, y->len);
+  return merge_count(x->col, x->len, y->col, y->len);
+}
+
+static void init_row(Jac_row *r, const eidx *row_ptr_t, const int *col_ind_t,
+                     int u) {
+  eidx k;
+
+  r->col = col_ind_t + row_ptr_t[u];
+  r->len = row_ptr_t[u + 1] - row_ptr_t[u];
+  r->distinct = 1;
+  for (k = 1; k < r->len && r->distinct; ++k)
+    r->distinct = r->col[k] != r->col[k - 1];
+  r->bits = NULL;
+}
+
+static double coefficient(const Jac_row *x, const Jac_row *y) {
+  eidx size_int = intersect(x, y);
+  eidx size_uni = x->len + y->len - size_int;
+
+  return size_uni > 0 ? (double)size_int / (double)size_uni : 0.;
+}
+
+/* Jaccard coefficient of the in-link sets of u and v, from the sorted rows
+ * of L^T. Two nodes without in-links have a coefficient of 0 */
+double jaccard_pair(const eidx *row_ptr_t, const int *col_ind_t, int u, int v) {
+  Jac_row x, y;
+
+  init_row(&x, row_ptr_t, col_ind_t, u);
+  init_row(&y, row_ptr_t, col_ind_t, v);
+  return coefficient(&x, &y);
+}
+
+/* Writes the Jaccard coefficients among the top_K nodes of v to
+ * <fname>_<method>_k<K>.jac: an int K, the K node ids, as ints, and the K x
+ * K coefficients, as floats, row after row. With text set they also go to
+ * <fname>_<method>_k<K>.csv and to stdout, one line per pair. Two nodes
+ * without in-links get 0, where the CSV used to hold -nan. ids maps node
+ * ids back to the ones of the input file when the nodes have been
+ * reordered, it is NULL otherwise */
+int compute_jaccard(const real *v, const eidx *row_ptr_t, const int *col_ind_t,
+                    int no_nodes, int top_K, const char *fname,
+                    const char *method, const int *ids, int no_threads,
+                    int text) {
   FILE *pf = NULL;
-  double **jaccard_coefficients = NULL;
+  float *jac;
+  Jac_row *rows;
+  unsigned long *bits;
   int *sorted_idx = NULL;
+  int *labels = NULL;
   int *degs = NULL;
   char fname_topk_jac[512] = {0};
-  double jaccard_coefficient;
-  int size_int, size_uni;
+  char phase[FNAME];
+  size_t words = ((size_t)no_nodes + 63) / 64;
+  eidx min_bits = no_nodes / BITMAP_RATIO;
   int i, j, k;
-  int ri, rj;
-  int rie, rje;
+  int err;
+  Metrics_mark begin;
 
-  /* Creating the K x K matrixes for the top-K Jaccard Coefficients */
-  jaccard_coefficients = (double **)malloc(top_K * sizeof(double *));
-  for (i = 0; i < top_K; ++i) {
-    jaccard_coefficients[i] = (double *)malloc(top_K * sizeof(double));
-  }
+  if (top_K > no_nodes) top_K = no_nodes;
+  if (top_K < 1) return EXIT_SUCCESS;
+  metrics_mark(&begin);
+  if (no_threads < 1) no_threads = 1;
+  if (min_bits < BITMAP_MIN) min_bits = BITMAP_MIN;
 
   /* Computing the top-K nodes for each distribution */
-  sorted_idx = index_sort_top_K(v, no_nodes, top_K);
+  sorted_idx = index_sort_top_K(v, no_nodes, top_K, no_threads);
+
+  labels = (int *)malloc(sizeof(int) * top_K);
+  for (k = 0; k < top_K; ++k)
+    labels[k] = ids != NULL ? ids[sorted_idx[k]] : sorted_idx[k];
 
   printf("Top-K nodes: ");
-  print_vec_d(sorted_idx, top_K);
+  print_vec_d(labels, top_K);
 
   degs = (int *)malloc(sizeof(int) * top_K);
   for (k = 0; k < top_K; ++k) {
     i = sorted_idx[k];
-    degs[k] = row_ptr_t[i + 1] - row_ptr_t[i];
+    degs[k] = (int)(row_ptr_t[i + 1] - row_ptr_t[i]);
   }
   printf("Degree distribution: ");
   print_vec_d(degs, top_K);
 
-  /* Creating CSV file for storing the results */
-  sprintf(fname_topk_jac, "%s_%s_k%d.csv", fname, method, top_K);
+  /* The rows of the hubs also get a bitmap */
+  rows = (Jac_row *)malloc(sizeof(Jac_row) * top_K);
+#pragma omp parallel for schedule(dynamic, 16) private(bits) \
+    num_threads(no_threads)
+  for (k = 0; k < top_K; ++k) {
+    eidx e;
 
-  if ((pf = fopen(fname_topk_jac, "w")) == NULL) {
-    fprintf(stderr, " [ERROR] cannot open output file \"%s\"\n",
-            fname_topk_jac);
-    exit(EXIT_FAILURE);
+    init_row(&rows[k], row_ptr_t, col_ind_t, sorted_idx[k]);
+    if (rows[k].distinct && rows[k].len >= min_bits) {
+      bits = (unsigned long *)calloc(words, sizeof(unsigned long));
+      for (e = 0; e < rows[k].len; ++e)
+        bits[rows[k].col[e] / 64] |= 1UL << (rows[k].col[e] % 64);
+      rows[k].bits = bits;
+    }
   }
-  fprintf(pf, "n1,n2,jac\n");
 
-  /* Computing Jaccard with a */
+  /* Every pair once, the rows being handed out dynamically since the
+   * cost of a row of pairs varies with the degrees */
+  jac = (float *)malloc(sizeof(float) * (size_t)top_K * top_K);
+#pragma omp parallel for schedule(dynamic, 1) private(j) \
+    num_threads(no_threads)
   for (i = 0; i < top_K; ++i) {
+    jac[(size_t)i * top_K + i] = rows[i].len > 0 ? 1.f : 0.f;
     for (j = i + 1; j < top_K; ++j) {
-      ri = row_ptr_t[sorted_idx[i]];
-      rj = row_ptr_t[sorted_idx[j]];
-      rie = row_ptr_t[sorted_idx[i] + 1];
-      rje = row_ptr_t[sorted_idx[j] + 1];
-      size_int = 0;
-      size_uni = 0;
-      while (ri < rie && rj < rje) {
-        if (col_ind_t[ri] < col_ind_t[rj]) {
-          ++ri;
-        } else if (col_ind_t[ri] > col_ind_t[rj]) {
-          ++rj;
-        } else {
-          ++size_int;
-          ++ri;
-          ++rj;
-        }
-        ++size_uni;
-      }
-      while (ri < rie) {
-        ++ri;
-        ++size_uni;
-      }
-      while (rj < rje) {
-        ++rj;
-        ++size_uni;
+      float c = (float)coefficient(&rows[i], &rows[j]);
+
+      jac[(size_t)i * top_K + j] = c;
+      jac[(size_t)j * top_K + i] = c;
+    }
+  }
+
+  sprintf(fname_topk_jac, "%s_%s_k%d.jac", fname, method, top_K);
+  if ((pf = fopen(fname_topk_jac, "wb")) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot create file \"%s\"\n", fname_topk_jac);
+    err = 1;
+  } else {
+    err = fwrite(&top_K, sizeof(int), 1, pf) != 1 ||
+          fwrite(labels, sizeof(int), top_K, pf) != (size_t)top_K ||
+          fwrite(jac, sizeof(float), (size_t)top_K * top_K, pf) !=
+              (size_t)top_K * top_K;
+    err = fclose(pf) != 0 || err;
+    if (err)
+      fprintf(stderr, " [ERROR] Cannot write file \"%s\"\n", fname_topk_jac);
+  }
+
+  /* Creating CSV file for storing the results */
+  sprintf(fname_topk_jac, "%s_%s_k%d.csv", fname, method, top_K);
+  if (!err && text && (pf = fopen(fname_topk_jac, "w")) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot create file \"%s\"\n", fname_topk_jac);
+    err = 1;
+  } else if (!err && text) {
+    fprintf(pf, "n1,n2,jac\n");
+    for (i = 0; i < top_K; ++i) {
+      for (j = i + 1; j < top_K; ++j) {
+        printf("J(%d,%d) = %.3f\n", labels[i], labels[j],
+               jac[(size_t)i * top_K + j]);
+        fprintf(pf, "%d,%d,%.3f\n", labels[i], labels[j],
+                jac[(size_t)i * top_K + j]);
       }
-      jaccard_coefficient = ((double)size_int) / ((double)size_uni);
-      jaccard_coefficients[i][j] = jaccard_coefficient;
-      jaccard_coefficients[j][i] = jaccard_coefficient;
-      printf("J(%d,%d) = %.3f\n", sorted_idx[i], sorted_idx[j],
-             jaccard_coefficient);
-      fprintf(pf, "%d,%d,%.3f\n", sorted_idx[i], sorted_idx[j],
-              jaccard_coefficient);
     }
+    fclose(pf);
   }
-  fclose(pf);
 
+  for (k = 0; k < top_K; ++k) free((void *)rows[k].bits);
+  free(rows);
+  free(jac);
   free(degs);
-  for (i = 0; i < top_K; ++i) {
-    free(jaccard_coefficients[i]);
-  }
-  free(jaccard_coefficients);
   free(sorted_idx);
+  free(labels);
+  /* One phase per vector, jaccard_a and jaccard_h */
+  sprintf(phase, "jaccard_%s", method);
+  metrics_phase(phase, &begin);
+  return err ? EXIT_FAILURE : EXIT_SUCCESS;
 }
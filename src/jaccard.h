@@ -1,7 +1,12 @@
 #ifndef JACCARD_H
 #define JACCARD_H
 
-void compute_jaccard(const double *v, const int *row_ptr_t, const int *col_ind_t, int no_nodes,
-                     int top_K, const char *fname, const char *method);
+#include "utils.h"
+
+double jaccard_pair(const eidx *row_ptr_t, const int *col_ind_t, int u, int v);
+int compute_jaccard(const real *v, const eidx *row_ptr_t, const int *col_ind_t,
+                    int no_nodes, int top_K, const char *fname,
+                    const char *method, const int *ids, int no_threads,
+                    int text);
 
 #endif
@@ -0,0 +1,265 @@
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "metrics.h"
+
+#define NAME_LEN 32
+
+/* A phase, or an iteration when iter >= 0 */
+typedef struct {
+  char name[NAME_LEN];
+  int iter;
+  double seconds, edges, bytes;
+  long ctr[NO_COUNTERS];
+} Metrics_record;
+
+static const char *ctr_names[NO_COUNTERS] = {"cycles", "llc_misses",
+                                             "llc_read_misses"};
+
+/* The recorder, enabled by metrics_open() */
+static struct {
+  int on;
+  char path[PATH];
+  char program[FNAME];
+  char dataset[PATH];
+  int no_threads;
+  double start;
+  /* Counter fds, NO_COUNTERS per thread, none if no_fds is 0 */
+  int *fds;
+  int no_fds;
+  Metrics_record *recs;
+  long len, cap;
+} met;
+
+/* Seconds on a monotonic clock, from an arbitrary origin */
+double wall_time(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1.e-9;
+}
+
+static int open_counter(unsigned int type, unsigned long config) {
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/* Opens the counters of every thread of a team of no_threads, which later
+ * parallel regions of at most as many threads reuse */
+static int open_counters(int no_threads) {
+  static const unsigned int types[NO_COUNTERS] = {
+      PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE};
+  static const unsigned long configs[NO_COUNTERS] = {
+      PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_CACHE_MISSES,
+      PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)};
+  int k, err = 0;
+
+  met.fds = (int *)malloc(sizeof(int) * NO_COUNTERS * no_threads);
+  for (k = 0; k < NO_COUNTERS * no_threads; ++k) met.fds[k] = -1;
+#pragma omp parallel num_threads(no_threads) reduction(| : err)
+  {
+    int *fd = met.fds + NO_COUNTERS * omp_get_thread_num();
+    int c;
+
+    for (c = 0; c < NO_COUNTERS && !err; ++c)
+      err = (fd[c] = open_counter(types[c], configs[c])) == -1 ? errno : 0;
+  }
+  if (err) {
+    printf("Hardware counters unavailable: %s\n", strerror(err));
+    for (k = 0; k < NO_COUNTERS * no_threads; ++k)
+      if (met.fds[k] != -1) close(met.fds[k]);
+    free(met.fds);
+    met.fds = NULL;
+    return EXIT_FAILURE;
+  }
+  met.no_fds = NO_COUNTERS * no_threads;
+  return EXIT_SUCCESS;
+}
+
+/* Starts recording, for a run of program on dataset with no_threads
+ * threads, the metrics being written to path by metrics_close(). With
+ * counters set the hardware counters are read too, if the system allows
+ * it */
+int metrics_open(const char *path, const char *program, const char *dataset,
+                 int no_threads, int counters) {
+  FILE *pf;
+
+  /* The file is created up front, not to find out it cannot be at the end
+   * of the run */
+  if ((pf = fopen(path, "w")) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot create file \"%s\"\n", path);
+    return EXIT_FAILURE;
+  }
+  fclose(pf);
+  memset(&met, 0, sizeof(met));
+  strncpy(met.path, path, PATH - 1);
+  strncpy(met.program, program, FNAME - 1);
+  strncpy(met.dataset, dataset, PATH - 1);
+  met.no_threads = no_threads > 0 ? no_threads : 1;
+  if (counters) open_counters(met.no_threads);
+  met.start = wall_time();
+  met.on = 1;
+  return EXIT_SUCCESS;
+}
+
+/* Current time, and counter totals over the threads */
+void metrics_mark(Metrics_mark *m) {
+  long v;
+  int k;
+
+  m->time = wall_time();
+  memset(m->ctr, 0, sizeof(m->ctr));
+  for (k = 0; k < met.no_fds; ++k)
+    if (read(met.fds[k], &v, sizeof(v)) == sizeof(v))
+      m->ctr[k % NO_COUNTERS] += v;
+}
+
+static void add_record(const char *name, int iter, const Metrics_mark *begin,
+                       const Metrics_mark *end, double edges, double bytes) {
+  Metrics_record *r;
+  int c;
+
+#pragma omp critical(metrics)
+  {
+    if (met.len == met.cap) {
+      met.cap = met.cap > 0 ? 2 * met.cap : 256;
+      met.recs = (Metrics_record *)realloc(
+          met.recs, sizeof(Metrics_record) * met.cap);
+    }
+    r = met.recs + met.len++;
+    strncpy(r->name, name, NAME_LEN - 1);
+    r->name[NAME_LEN - 1] = '\0';
+    r->iter = iter;
+    r->seconds = end->time - begin->time;
+    r->edges = edges;
+    r->bytes = bytes;
+    for (c = 0; c < NO_COUNTERS; ++c) r->ctr[c] = end->ctr[c] - begin->ctr[c];
+  }
+}
+
+/* Records the phase name, from begin until now. Returns its wall time in
+ * seconds, recording or not */
+double metrics_phase(const char *name, const Metrics_mark *begin) {
+  Metrics_mark end;
+
+  if (!met.on) return wall_time() - begin->time;
+  metrics_mark(&end);
+  add_record(name, -1, begin, &end, 0., 0.);
+  return end.time - begin->time;
+}
+
+/* Records iteration iter of the solver name, from begin until now. It went
+ * through edges edges and about bytes bytes of memory */
+void metrics_iter(const char *name, int iter, const Metrics_mark *begin,
+                  double edges, double bytes) {
+  Metrics_mark end;
+
+  if (!met.on) return;
+  metrics_mark(&end);
+  add_record(name, iter, begin, &end, edges, bytes);
+}
+
+/* Bytes of memory traffic of a CSR product with no_nodes rows and
+ * no_edges entries, when no gathered value stays in cache: the row
+ * offsets, the column indices and one gathered value per entry, the
+ * result and the source vector */
+double spmv_bytes(int no_nodes, eidx no_edges) {
+  return (double)no_edges * (sizeof(int) + sizeof(real)) +
+         (double)no_nodes * (sizeof(eidx) + 2 * sizeof(real));
+}
+
+static void write_counters(FILE *pf, const Metrics_record *r) {
+  int c;
+
+  if (met.no_fds == 0) return;
+  for (c = 0; c < NO_COUNTERS; ++c)
+    fprintf(pf, ", \"%s\": %ld", ctr_names[c], r->ctr[c]);
+  fprintf(pf, ", \"bytes_read\": %ld",
+          r->ctr[NO_COUNTERS - 1] * METRICS_LINE);
+}
+
+static void write_string(FILE *pf, const char *s) {
+  fputc('"', pf);
+  for (; *s != '\0'; ++s) {
+    if (*s == '"' || *s == '\\') fputc('\\', pf);
+    if ((unsigned char)*s >= 0x20) fputc(*s, pf);
+  }
+  fputc('"', pf);
+}
+
+/* Writes the metrics recorded so far and stops recording */
+int metrics_close(void) {
+  const Metrics_record *r;
+  FILE *pf;
+  long k;
+  int first, err;
+
+  if (!met.on) return EXIT_SUCCESS;
+  met.on = 0;
+  if ((pf = fopen(met.path, "w")) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot create file \"%s\"\n", met.path);
+    err = 1;
+  } else {
+    fprintf(pf, "{\n  \"program\": ");
+    write_string(pf, met.program);
+    fprintf(pf, ",\n  \"dataset\": ");
+    write_string(pf, met.dataset);
+    fprintf(pf, ",\n  \"threads\": %d,\n  \"counters\": %s,\n",
+            met.no_threads, met.no_fds > 0 ? "true" : "false");
+    fprintf(pf, "  \"total_seconds\": %.6f,\n", wall_time() - met.start);
+
+    fprintf(pf, "  \"phases\": [");
+    for (k = 0, first = 1; k < met.len; ++k) {
+      r = met.recs + k;
+      if (r->iter >= 0) continue;
+      fprintf(pf, "%s\n    {\"name\": ", first ? "" : ",");
+      write_string(pf, r->name);
+      fprintf(pf, ", \"seconds\": %.6f", r->seconds);
+      write_counters(pf, r);
+      fprintf(pf, "}");
+      first = 0;
+    }
+    fprintf(pf, "\n  ],\n  \"iterations\": [");
+    for (k = 0, first = 1; k < met.len; ++k) {
+      r = met.recs + k;
+      if (r->iter < 0) continue;
+      fprintf(pf, "%s\n    {\"name\": ", first ? "" : ",");
+      write_string(pf, r->name);
+      fprintf(pf, ", \"iter\": %d, \"seconds\": %.6f", r->iter, r->seconds);
+      if (r->seconds > 0.)
+        fprintf(pf, ", \"edges_per_s\": %.4g, \"gb_per_s\": %.4g",
+                r->edges / r->seconds, r->bytes / r->seconds * 1.e-9);
+      write_counters(pf, r);
+      if (met.no_fds > 0 && r->seconds > 0.)
+        fprintf(pf, ", \"read_gb_per_s\": %.4g",
+                (double)r->ctr[NO_COUNTERS - 1] * METRICS_LINE /
+                    r->seconds * 1.e-9);
+      fprintf(pf, "}");
+      first = 0;
+    }
+    fprintf(pf, "\n  ]\n}\n");
+    err = fclose(pf) != 0;
+    if (err) fprintf(stderr, " [ERROR] Cannot write file \"%s\"\n", met.path);
+  }
+
+  for (k = 0; k < met.no_fds; ++k) close(met.fds[k]);
+  free(met.fds);
+  free(met.recs);
+  memset(&met, 0, sizeof(met));
+  return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
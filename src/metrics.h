@@ -0,0 +1,32 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "utils.h"
+
+/* Instrumentation: wall-clock timers for the phases and the iterations of
+ * the engines, optionally with hardware counters, written to a JSON file.
+ * Recording is process-wide, unlike the rest of libirws, and off until
+ * metrics_open() is called: the marks then only keep the time. The
+ * counters (cycles, last level cache misses, and the bytes read from
+ * memory, estimated as METRICS_LINE bytes per last level cache read miss)
+ * are opened with perf_event_open() on the threads that run
+ * metrics_open(), and only count user space */
+#define NO_COUNTERS 3
+#define METRICS_LINE 64
+
+typedef struct {
+  double time;
+  long ctr[NO_COUNTERS];
+} Metrics_mark;
+
+double wall_time(void);
+int metrics_open(const char *path, const char *program, const char *dataset,
+                 int no_threads, int counters);
+int metrics_close(void);
+void metrics_mark(Metrics_mark *m);
+double metrics_phase(const char *name, const Metrics_mark *begin);
+void metrics_iter(const char *name, int iter, const Metrics_mark *begin,
+                  double edges, double bytes);
+double spmv_bytes(int no_nodes, eidx no_edges);
+
+#endif
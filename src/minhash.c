@@ -0,0 +1,373 @@
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jaccard.h"
+#include "metrics.h"
+#include "minhash.h"
+
+/* The band keys are spread over 2^PART_BITS parts by their top bits, and
+ * the parts are sorted and joined in parallel */
+#define PART_BITS 10
+#define NO_PARTS (1 << PART_BITS)
+
+typedef struct {
+  unsigned key;
+  int node;
+} Lsh_entry;
+
+typedef struct {
+  int u, v;
+  double jac;
+} Join_pair;
+
+typedef struct {
+  Join_pair *pairs;
+  long len, cap;
+} Pair_buf;
+
+/* Candidate pair of rows, u < v */
+typedef struct {
+  int u, v;
+} Cand_pair;
+
+typedef struct {
+  Cand_pair *pairs;
+  long len, cap;
+} Cand_buf;
+
+/* Mixes x with seed, as the finalizer of MurmurHash3 */
+static unsigned mix32(unsigned x, unsigned seed) {
+  x ^= seed;
+  x ^= x >> 16;
+  x *= 0x85ebca6bU;
+  x ^= x >> 13;
+  x *= 0xc2b2ae35U;
+  x ^= x >> 16;
+  return x;
+}
+
+static int cmp_entry(const void *a, const void *b) {
+  const Lsh_entry *x = (const Lsh_entry *)a, *y = (const Lsh_entry *)b;
+
+  if (x->key != y->key) return x->key < y->key ? -1 : 1;
+  return x->node - y->node;
+}
+
+static int cmp_pair(const void *a, const void *b) {
+  const Join_pair *x = (const Join_pair *)a, *y = (const Join_pair *)b;
+
+  if (x->u != y->u) return x->u < y->u ? -1 : 1;
+  return x->v - y->v;
+}
+
+static int cmp_cand(const void *a, const void *b) {
+  const Cand_pair *x = (const Cand_pair *)a, *y = (const Cand_pair *)b;
+
+  if (x->u != y->u) return x->u < y->u ? -1 : 1;
+  return x->v - y->v;
+}
+
+static void push_cand(Cand_buf *buf, int u, int v) {
+  if (buf->len == buf->cap) {
+    buf->cap = buf->cap > 0 ? 2 * buf->cap : 1024;
+    buf->pairs =
+        (Cand_pair *)realloc(buf->pairs, sizeof(Cand_pair) * buf->cap);
+  }
+  buf->pairs[buf->len].u = u;
+  buf->pairs[buf->len].v = v;
+  ++buf->len;
+}
+
+/* Gathers the candidates of the no_threads buffers of bufs in bufs[0],
+ * and keeps there only those that are not in seen, the sorted candidates of
+ * the earlier bands, to which they are added */
+static void new_candidates(Cand_buf *bufs, int no_threads, Cand_buf *seen) {
+  Cand_buf *c = bufs;
+  Cand_pair *all;
+  long i, j, k, m;
+  int t;
+
+  for (t = 1; t < no_threads; ++t) {
+    if (c->len + bufs[t].len > c->cap) {
+      c->cap = c->len + bufs[t].len;
+      c->pairs = (Cand_pair *)realloc(c->pairs, sizeof(Cand_pair) * c->cap);
+    }
+    memcpy(c->pairs + c->len, bufs[t].pairs, sizeof(Cand_pair) * bufs[t].len);
+    c->len += bufs[t].len;
+    bufs[t].len = 0;
+  }
+  qsort(c->pairs, c->len, sizeof(Cand_pair), cmp_cand);
+
+  /* Drops the copies and the pairs of seen, both lists being sorted */
+  for (i = 0, j = 0, m = 0; i < c->len; ++i) {
+    if (m > 0 && cmp_cand(c->pairs + i, c->pairs + m - 1) == 0) continue;
+    while (j < seen->len && cmp_cand(seen->pairs + j, c->pairs + i) < 0) ++j;
+    if (j < seen->len && cmp_cand(seen->pairs + j, c->pairs + i) == 0)
+      continue;
+    c->pairs[m++] = c->pairs[i];
+  }
+  c->len = m;
+
+  all = (Cand_pair *)malloc(sizeof(Cand_pair) * (seen->len + c->len + 1));
+  for (i = 0, j = 0, k = 0; i < seen->len || j < c->len; ++k)
+    all[k] = j == c->len || (i < seen->len &&
+                             cmp_cand(seen->pairs + i, c->pairs + j) < 0)
+                 ? seen->pairs[i++]
+                 : c->pairs[j++];
+  free(seen->pairs);
+  seen->pairs = all;
+  seen->len = seen->cap = k;
+}
+
+static void push_pair(Pair_buf *buf, int u, int v, double jac) {
+  if (buf->len == buf->cap) {
+    buf->cap = buf->cap > 0 ? 2 * buf->cap : 1024;
+    buf->pairs =
+        (Join_pair *)realloc(buf->pairs, sizeof(Join_pair) * buf->cap);
+  }
+  buf->pairs[buf->len].u = u;
+  buf->pairs[buf->len].v = v;
+  buf->pairs[buf->len].jac = jac;
+  ++buf->len;
+}
+
+/* Number of bands, and of rows per band, for a signature of no_hashes
+ * hashes: the most rows for which a pair of coefficient threshold still
+ * shares a band key, 1 - (1 - threshold^rows)^bands, with probability
+ * MH_RECALL. More rows make fewer candidates below the threshold */
+void lsh_bands(int no_hashes, double threshold, int *bands, int *rows) {
+  int r;
+
+  *rows = 1;
+  *bands = no_hashes;
+  for (r = 2; r <= no_hashes; ++r) {
+    if (1. - pow(1. - pow(threshold, r), no_hashes / r) < MH_RECALL) break;
+    *rows = r;
+    *bands = no_hashes / r;
+  }
+}
+
+/* Key of band b of row u: the hash of its rows MinHash values */
+static unsigned band_key(const eidx *row_ptr, const int *col_ind, int u,
+                         int b, int rows) {
+  unsigned mins[MH_HASHES];
+  unsigned key = 0x9e3779b9U, h;
+  eidx e;
+  int k;
+
+  for (k = 0; k < rows; ++k) mins[k] = ~0U;
+  for (e = row_ptr[u]; e < row_ptr[u + 1]; ++e) {
+    for (k = 0; k < rows; ++k) {
+      h = mix32((unsigned)col_ind[e], 0x5bd1e995U * (unsigned)(b * rows + k));
+      if (h < mins[k]) mins[k] = h;
+    }
+  }
+  for (k = 0; k < rows; ++k) key = mix32(key * 31U + mins[k], (unsigned)b);
+  return key;
+}
+
+/* Exact Jaccard coefficient of rows u and v. Sorted rows are merged,
+ * unsorted ones counted in cnt, a zeroed array of no_nodes entries that is
+ * left zeroed */
+static double verify(const eidx *row_ptr, const int *col_ind, int sorted,
+                     int *cnt, int u, int v) {
+  eidx e, size_int = 0, size_uni;
+
+  if (sorted) return jaccard_pair(row_ptr, col_ind, u, v);
+  for (e = row_ptr[u]; e < row_ptr[u + 1]; ++e) ++cnt[col_ind[e]];
+  for (e = row_ptr[v]; e < row_ptr[v + 1]; ++e) {
+    if (cnt[col_ind[e]] > 0) {
+      --cnt[col_ind[e]];
+      ++size_int;
+    }
+  }
+  for (e = row_ptr[u]; e < row_ptr[u + 1]; ++e) cnt[col_ind[e]] = 0;
+  size_uni = (row_ptr[u + 1] - row_ptr[u]) + (row_ptr[v + 1] - row_ptr[v]) -
+             size_int;
+  return size_uni > 0 ? (double)size_int / (double)size_uni : 0.;
+}
+
+/* Writes to path, as "n1,n2,jac" lines, the pairs of rows of (row_ptr,
+ * col_ind) whose Jaccard coefficient is at least threshold, found by
+ * MinHash and LSH. sorted tells whether the rows are sorted. Empty rows are
+ * left out. ids maps node ids back to the ones of the input file when the
+ * nodes have been reordered, it is NULL otherwise */
+int similarity_join(const eidx *row_ptr, const int *col_ind, int no_nodes,
+                    int sorted, double threshold, const int *ids,
+                    const char *path, int no_threads, int verbose) {
+  Pair_buf *bufs;
+  Cand_buf *cands, seen = {NULL, 0, 0};
+  int **cnts;
+  Lsh_entry *entries;
+  unsigned *key;
+  int *nodes;
+  long *count;
+  long no_cand = 0, no_skipped = 0, no_pairs, k;
+  FILE *pf;
+  int bands, rows, b, t, p, no_rows = 0;
+  int u;
+  int err;
+  Metrics_mark begin;
+
+  metrics_mark(&begin);
+  if (no_threads < 1) no_threads = 1;
+  lsh_bands(MH_HASHES, threshold, &bands, &rows);
+  if (verbose)
+    printf("Similarity join at %.3f: %d bands of %d MinHash values\n",
+           threshold, bands, rows);
+
+  nodes = (int *)malloc(sizeof(int) * no_nodes);
+  for (u = 0; u < no_nodes; ++u)
+    if (row_ptr[u + 1] > row_ptr[u]) nodes[no_rows++] = u;
+  key = (unsigned *)malloc(sizeof(unsigned) * ((size_t)no_rows + 1));
+  entries = (Lsh_entry *)malloc(sizeof(Lsh_entry) * ((size_t)no_rows + 1));
+  count = (long *)calloc((size_t)(no_threads + 1) * NO_PARTS, sizeof(long));
+  bufs = (Pair_buf *)calloc(no_threads, sizeof(Pair_buf));
+  cands = (Cand_buf *)calloc(no_threads, sizeof(Cand_buf));
+  cnts = (int **)calloc(no_threads, sizeof(int *));
+
+  for (b = 0; b < bands; ++b) {
+    /* Keys of the band, then bucketed by part: every thread counts and
+     * scatters the same static range of rows */
+#pragma omp parallel num_threads(no_threads) private(t, p, k)
+    {
+      int nt = omp_get_num_threads();
+      long lo, hi, *cur;
+
+      t = omp_get_thread_num();
+      lo = (long)no_rows * t / nt;
+      hi = (long)no_rows * (t + 1) / nt;
+      cur = count + (size_t)(t + 1) * NO_PARTS;
+      memset(cur, 0, sizeof(long) * NO_PARTS);
+      for (k = lo; k < hi; ++k) {
+        key[k] = band_key(row_ptr, col_ind, nodes[k], b, rows);
+        ++cur[key[k] >> (32 - PART_BITS)];
+      }
+#pragma omp barrier
+#pragma omp single
+      {
+        long sum = 0, c;
+        int s;
+
+        for (p = 0; p < NO_PARTS; ++p) {
+          count[p] = sum;
+          for (s = 1; s <= nt; ++s) {
+            c = count[(size_t)s * NO_PARTS + p];
+            count[(size_t)s * NO_PARTS + p] = sum;
+            sum += c;
+          }
+        }
+      }
+      for (k = lo; k < hi; ++k) {
+        p = key[k] >> (32 - PART_BITS);
+        entries[cur[p]].key = key[k];
+        entries[cur[p]].node = nodes[k];
+        ++cur[p];
+      }
+    }
+
+    /* Every bucket of every part gives its pairs as candidates */
+#pragma omp parallel for schedule(dynamic, 4) num_threads(no_threads) \
+    reduction(+ : no_skipped)
+    for (p = 0; p < NO_PARTS; ++p) {
+      Cand_buf *buf = cands + omp_get_thread_num();
+      long lo = count[p], hi = p + 1 < NO_PARTS ? count[p + 1] : no_rows;
+      long i, j, end;
+
+      qsort(entries + lo, hi - lo, sizeof(Lsh_entry), cmp_entry);
+      for (i = lo; i < hi; i = end) {
+        for (end = i + 1; end < hi && entries[end].key == entries[i].key;
+             ++end)
+          ;
+        if (end - i > MH_MAX_BUCKET) {
+          no_skipped += end - i;
+          continue;
+        }
+        /* Entries of a key are sorted by node, so u < v */
+        for (; i < end; ++i)
+          for (j = i + 1; j < end; ++j)
+            push_cand(buf, entries[i].node, entries[j].node);
+      }
+    }
+
+    /* A pair that shares the keys of several bands is verified in the
+     * first one only */
+    new_candidates(cands, no_threads, &seen);
+    no_cand += cands[0].len;
+#pragma omp parallel for schedule(dynamic, 1024) num_threads(no_threads)
+    for (k = 0; k < cands[0].len; ++k) {
+      int **cnt = cnts + omp_get_thread_num();
+      const Cand_pair *q = cands[0].pairs + k;
+      double jac;
+
+      if (!sorted && *cnt == NULL)
+        *cnt = (int *)calloc(no_nodes, sizeof(int));
+      jac = verify(row_ptr, col_ind, sorted, *cnt, q->u, q->v);
+      if (jac >= threshold)
+        push_pair(bufs + omp_get_thread_num(), q->u, q->v, jac);
+    }
+    cands[0].len = 0;
+  }
+
+  for (t = 1, no_pairs = bufs[0].len; t < no_threads; ++t) {
+    bufs[0].pairs = (Join_pair *)realloc(
+        bufs[0].pairs, sizeof(Join_pair) * (no_pairs + bufs[t].len + 1));
+    memcpy(bufs[0].pairs + no_pairs, bufs[t].pairs,
+           sizeof(Join_pair) * bufs[t].len);
+    no_pairs += bufs[t].len;
+    free(bufs[t].pairs);
+  }
+
+  /* The similar pairs, by input ids */
+  for (k = 0; k < no_pairs; ++k) {
+    Join_pair *q = bufs[0].pairs + k;
+
+    if (ids != NULL) {
+      q->u = ids[q->u];
+      q->v = ids[q->v];
+    }
+    if (q->u > q->v) {
+      u = q->u;
+      q->u = q->v;
+      q->v = u;
+    }
+  }
+  qsort(bufs[0].pairs, no_pairs, sizeof(Join_pair), cmp_pair);
+
+  if (verbose) {
+    printf("%ld candidate pairs verified, %ld similar pairs\n", no_cand,
+           no_pairs);
+    if (no_skipped > 0)
+      printf("%ld rows of buckets of more than %d rows were skipped\n",
+             no_skipped, MH_MAX_BUCKET);
+  }
+
+  if ((pf = fopen(path, "w")) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot create file \"%s\"\n", path);
+    err = 1;
+  } else {
+    fprintf(pf, "n1,n2,jac\n");
+    for (k = 0; k < no_pairs; ++k)
+      fprintf(pf, "%d,%d,%.3f\n", bufs[0].pairs[k].u, bufs[0].pairs[k].v,
+              bufs[0].pairs[k].jac);
+    err = fclose(pf) != 0;
+    if (err) fprintf(stderr, " [ERROR] Cannot write file \"%s\"\n", path);
+  }
+
+  for (t = 0; t < no_threads; ++t) free(cnts[t]);
+  free(cnts);
+  for (t = 0; t < no_threads; ++t) free(cands[t].pairs);
+  free(cands);
+  free(seen.pairs);
+  free(bufs[0].pairs);
+  free(bufs);
+  free(count);
+  free(entries);
+  free(key);
+  free(nodes);
+  metrics_phase("join", &begin);
+  return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
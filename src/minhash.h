@@ -0,0 +1,24 @@
+#ifndef MINHASH_H
+#define MINHASH_H
+
+#include "utils.h"
+
+/* Approximate similarity join over the whole graph. Every row of a CSR
+ * matrix gets a MinHash signature of MH_HASHES hashes, cut in bands of rows
+ * hashes; two rows sharing the key of one band are candidates, and the
+ * candidates are verified exactly. The signatures are never stored: the
+ * keys of one band are computed, bucketed and joined before the next. The
+ * candidate pairs found so far are kept, sorted, to verify every pair once.
+ * The bands are chosen so that a pair at the threshold is found with
+ * probability MH_RECALL. Buckets larger than MH_MAX_BUCKET are skipped in
+ * their band, their pairs may still be found in the others */
+#define MH_HASHES 64
+#define MH_RECALL 0.9
+#define MH_MAX_BUCKET 2048
+
+void lsh_bands(int no_hashes, double threshold, int *bands, int *rows);
+int similarity_join(const eidx *row_ptr, const int *col_ind, int no_nodes,
+                    int sorted, double threshold, const int *ids,
+                    const char *path, int no_threads, int verbose);
+
+#endif
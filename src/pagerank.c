@@ -1,415 +1,465 @@
 #include <dirent.h>
 #include <fcntl.h>
-#include <float.h>
-#include <math.h>
+#include <getopt.h>
+#include <omp.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
-#include <sys/stat.h>
 #include <sys/types.h>
-#include <time.h>
 #include <unistd.h>
 
-#include "utils.h"
+#include "irws.h"
+#include "metrics.h"
+#include "ppr.h"
+#include "push.h"
 
-/* Data to save/load CSR matrix */
+/* Cache and result file names */
 char fname[FNAME] = {0};
 char dir[DNAME] = {0};
-char row_ptr_p[PATH] = {0};
-char col_ind_p[PATH] = {0};
-char val_p[PATH] = {0};
-char danglings_p[PATH] = {0};
-char csr_data_p[PATH] = {0};
 char fres[PATH] = {0};
-CSR_data csr_data = {0};
-int no_nodes = 0, no_edges = 0;
-
-/* Pagerank computation data */
-int *danglings = NULL;
-int no_danglings = 0;
-double danglings_dot_product = 0;
-double *p = NULL, *p_new = NULL;
-
-/* CSR matrix representation */
-double *val = NULL;
-int *col_ind = NULL;
-int *row_ptr = NULL;
-
-void perform_compression(const char dataset_path[FNAME]);
-void compute_pagerank(void);
+char ftop[PATH] = {0};
+char ftop_csv[PATH] = {0};
+int no_threads = 1;
+
+/* Node reordering applied at compression time */
+char order_method[FNAME] = {0};
+
+/* Solver: "jacobi" (power iteration, the default), "gs" (Gauss-Seidel),
+ * "extrap" (power iteration with quadratic extrapolation), "bicgstab" or
+ * "adaptive" (power iteration that freezes the converged nodes) */
+char solver[FNAME] = {0};
+
+/* Edge delta merged into the cache before the computation, which then
+ * starts from the previous result */
+char delta_p[PATH] = {0};
+
+/* Reference result to compare against */
+char ref_dir[DNAME] = {0};
+char fref[DNAME + PATH] = {0};
+
+/* Batched personalized PageRank, computed instead of the global one when a
+ * seed file is given */
+char seeds_p[PATH] = {0};
+char fppr[PATH] = {0};
+int batch = PPR_BATCH;
+
+/* Local push query from a single node, served from the forward adjacency
+ * (A, built from AT on the first query) */
+char out_ptr_p[PATH] = {0};
+char out_ind_p[PATH] = {0};
+char ids_p[PATH] = {0};
+char fpush[PATH + 16] = {0};
+int query_node = -1;
+double push_eps = PUSH_EPS;
+
+/* Use the gap/varint compressed col_ind */
+int compressed = 0;
+
+/* Kernel of the products: "csr" (the plain rows) or "tiled" (the rows cut
+ * in cache-sized tiles of columns) */
+int tiled = 0;
+
+/* Memory budget in MB of the out-of-core solver, 0 to solve in memory */
+long mem_mb = 0;
+
+/* Length of the ranked list written with --top, 0 for none */
+int rank_K = 0;
+
+/* JSON file the phase and iteration metrics are written to with
+ * --metrics, with the hardware counters if --counters is given */
+char metrics_p[PATH] = {0};
+int counters = 0;
+
+/* Check every section of the cache against its checksum before use, a
+ * full read of the cache that -m runs are meant to avoid */
+int verify = 0;
+
+/* Long options, returned by getopt_long() past the range of chars */
+#define OPT_TOP 256
+#define OPT_METRICS 257
+#define OPT_COUNTERS 258
+#define OPT_VERIFY 259
+static const struct option long_opts[] = {
+    {"top", required_argument, NULL, OPT_TOP},
+    {"metrics", required_argument, NULL, OPT_METRICS},
+    {"counters", no_argument, NULL, OPT_COUNTERS},
+    {"verify", no_argument, NULL, OPT_VERIFY},
+    {NULL, 0, NULL, 0}};
+
+/* Place the rows of every thread and their part of the vectors on the
+ * thread's NUMA node */
+int numa = 0;
+
+int query_push(const PR_graph *g);
+
+static void close_metrics(void) { metrics_close(); }
 
 int main(int argc, char *argv[]) {
-  /* Reading data from input file */
-  ssize_t bytes = 0;
-  FILE *pdata = NULL;
+  /* Graph and PageRank vector */
+  PR_graph g;
+  PR_options pr_opt;
+  real *p;
 
   /* Extra data */
-  struct stat st = {0};
+  const char *dataset = NULL;
   int err = 0;
+  char cache_p[DNAME + FNAME];
+  int status, flags;
+  int opt;
   int i;
 #ifdef DEBUG
   int j;
 #endif
 
-  if (argc != 2) {
-    fprintf(stderr, " [ERROR] *1* argument required: ./pagerank <arg_name>\n");
+  while ((opt = getopt_long(argc, argv, "t:r:zo:s:p:b:q:e:u:m:nk:",
+                            long_opts, NULL)) != -1) {
+    switch (opt) {
+      case 't':
+        if (sscanf(optarg, "%d", &no_threads) != 1 || no_threads < 1) {
+          fprintf(stderr, " [ERROR] Invalid number of threads \"%s\"\n",
+                  optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      case 'r':
+        strncpy(ref_dir, optarg, DNAME - 1);
+        break;
+      case 'z':
+        compressed = 1;
+        break;
+      case 'n':
+#ifndef NUMA
+        fprintf(stderr, " [ERROR] -n needs a build with "
+                        "\"make CFLAGS=-DNUMA\"\n");
+        exit(EXIT_FAILURE);
+#endif
+        numa = 1;
+        break;
+      case 'o':
+        strncpy(order_method, optarg, FNAME - 1);
+        break;
+      case 'k':
+        if (strcmp(optarg, "csr") != 0 && strcmp(optarg, "tiled") != 0) {
+          fprintf(stderr, " [ERROR] Unknown kernel \"%s\"\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        tiled = strcmp(optarg, "tiled") == 0;
+        break;
+      case 's':
+        if (strcmp(optarg, "jacobi") != 0 && strcmp(optarg, "gs") != 0 &&
+            strcmp(optarg, "extrap") != 0 && strcmp(optarg, "bicgstab") != 0 &&
+            strcmp(optarg, "adaptive") != 0) {
+          fprintf(stderr, " [ERROR] Unknown solver \"%s\"\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        strcpy(solver, optarg);
+        break;
+      case 'p':
+        strncpy(seeds_p, optarg, PATH - 1);
+        break;
+      case 'u':
+        strncpy(delta_p, optarg, PATH - 1);
+        break;
+      case 'q':
+        if (sscanf(optarg, "%d", &query_node) != 1 || query_node < 0) {
+          fprintf(stderr, " [ERROR] Invalid query node \"%s\"\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      case 'e':
+        if (sscanf(optarg, "%lf", &push_eps) != 1 || push_eps <= 0.) {
+          fprintf(stderr, " [ERROR] Invalid epsilon \"%s\"\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      case 'm':
+        if (sscanf(optarg, "%ld", &mem_mb) != 1 || mem_mb < 1) {
+          fprintf(stderr, " [ERROR] Invalid memory budget \"%s\"\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      case OPT_TOP:
+        if (sscanf(optarg, "%d", &rank_K) != 1 || rank_K < 1) {
+          fprintf(stderr, " [ERROR] Invalid top-K \"%s\"\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      case OPT_METRICS:
+        strncpy(metrics_p, optarg, PATH - 1);
+        break;
+      case OPT_COUNTERS:
+        counters = 1;
+        break;
+      case OPT_VERIFY:
+        verify = 1;
+        break;
+      case 'b':
+        if (sscanf(optarg, "%d", &batch) != 1 || batch < 1 ||
+            batch > PPR_MAX_BATCH) {
+          fprintf(stderr, " [ERROR] Batch size must be in [1, %d]\n",
+                  PPR_MAX_BATCH);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      default:
+        fprintf(stderr,
+                " [ERROR] Usage: ./pagerank [-t <threads>] [-r <ref_dir>] "
+                "[-z] [-o degree|rcm] [-k csr|tiled] "
+                "[-s jacobi|gs|extrap|bicgstab|adaptive] "
+                "[-p <seeds_file> [-b <batch>]] [-q <node> [-e <eps>]] "
+                "[-u <delta_file>] [-m <MB>] [-n] [--top <K>] "
+                "[--verify] [--metrics <json_file> [--counters]] "
+                "<arg_name>\n");
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  if (argc - optind != 1) {
+    fprintf(stderr, " [ERROR] *1* argument required: ./pagerank "
+                    "[<options>] <arg_name>\n");
     exit(EXIT_FAILURE);
   }
+  dataset = argv[optind];
+  if (compressed && tiled) {
+    fprintf(stderr, " [ERROR] -z and -k tiled cannot be used together\n");
+    exit(EXIT_FAILURE);
+  }
+  if (mem_mb > 0 && solver[0] != '\0' && strcmp(solver, "jacobi") != 0) {
+    fprintf(stderr, " [ERROR] -m only supports the jacobi solver\n");
+    exit(EXIT_FAILURE);
+  }
+  if (solver[0] == '\0') strcpy(solver, "jacobi");
+  if (metrics_p[0] != '\0') {
+    if (metrics_open(metrics_p, "pagerank", dataset, no_threads, counters) ==
+        EXIT_FAILURE)
+      exit(EXIT_FAILURE);
+    atexit(close_metrics);
+  }
 
   /* Init data folder name */
-  strncpy(fname, argv[1] + 5, strlen(argv[1]) - 9);
-  fname[strlen(argv[1]) - 8] = '\0';
+  strncpy(fname, dataset + 5, strlen(dataset) - 9);
+  fname[strlen(dataset) - 8] = '\0';
   strcpy(dir, "PR_");
   dir[3] = '\0';
   strcat(dir, fname);
   dir[3 + strlen(fname)] = '/';
   dir[3 + strlen(fname) + 1] = '\0';
 
-  /* Create CSR file names */
-  strcpy(row_ptr_p, dir);
-  strcat(row_ptr_p, "row_ptr.bin");
-  strcpy(col_ind_p, dir);
-  strcat(col_ind_p, "col_ind.bin");
-  strcpy(val_p, dir);
-  strcat(val_p, "val.bin");
-  strcpy(danglings_p, dir);
-  strcat(danglings_p, "danglings.bin");
-
-  /* Create CSR metadata file */
-  strcpy(csr_data_p, dir);
-  strcat(csr_data_p, "csr_data.bin");
+  /* Create the file names used by push queries */
+  strcpy(ids_p, dir);
+  strcat(ids_p, "ids.bin");
+  strcpy(out_ptr_p, dir);
+  strcat(out_ptr_p, "out_ptr.bin");
+  strcpy(out_ind_p, dir);
+  strcat(out_ind_p, "out_ind.bin");
 
   /* Create file to save PageRank result */
   strcpy(fres, fname);
   strcat(fres, ".pr");
-
-  /* Check if input data has already been compressed.
-   * If data has NOT yet been compressed, then perform compression */
-  if (stat(dir, &st) == -1) {
-    perform_compression(argv[1]);
+  sprintf(ftop, "%s.top", fname);
+  sprintf(ftop_csv, "%s_top.csv", fname);
+  sprintf(fref, "%s/%s", ref_dir, fres);
+  strcpy(fppr, fname);
+  strcat(fppr, ".ppr");
+  sprintf(fpush, "%s_push%d.csv", fname, query_node);
+
+  /* The input is compressed when it has no cache yet, and again when the
+   * cache is older than the input or incomplete */
+  strcpy(cache_p, dir);
+  strcat(cache_p, CACHE_FILE);
+  status = cache_check(cache_p, dataset);
+  if (status == CACHE_STALE)
+    printf("\"%s\" changed since \"%s\" was built\n", dataset, cache_p);
+  else if (status == CACHE_INVALID)
+    printf("\"%s\" is incomplete or from another version\n", cache_p);
+  if (status != CACHE_OK) {
+    if (pr_build(dataset, dir, order_method, no_threads, 1) == EXIT_FAILURE)
+      exit(EXIT_FAILURE);
+  } else if (order_method[0] != '\0') {
+    printf("Data already compressed, \"-o %s\" is ignored\n\n",
+           order_method);
   }
+  if (delta_p[0] != '\0' &&
+      pr_update(dir, delta_p, no_threads, 1) == EXIT_FAILURE)
+    exit(EXIT_FAILURE);
 
-  /* Reading CSR matrix metadata info from file */
+  /* mmapping the CSR matrix data from the cache file. A damaged cache is
+   * rebuilt, sections that do not match their checksum being only found
+   * with --verify, unless it was just updated */
   printf("Reading csr matrix data...\n");
-  pdata = fopen(csr_data_p, "rb");
-  bytes = fread(&no_nodes, sizeof(csr_data.no_nodes), 1, pdata);
-  bytes = fread(&no_edges, sizeof(csr_data.no_edges), 1, pdata);
-  bytes = fread(&no_danglings, sizeof(csr_data.no_danglings), 1, pdata);
-  (void)bytes;
-  fclose(pdata);
-  printf("no_nodes: %d\nno_edges: %d\nno_danglings: %d\n", no_nodes, no_edges,
-         no_danglings);
-
-  /* mmapping the CSR matrix data from files */
-  err = 0;
-
-  if ((row_ptr = (int *)mmap_data(row_ptr_p, sizeof(int), no_nodes + 1)) ==
-      MAP_FAILED)
-    ++err;
-  else if ((col_ind = (int *)mmap_data(col_ind_p, sizeof(int), no_edges)) ==
-           MAP_FAILED)
-    ++err;
-  else if ((val = (double *)mmap_data(val_p, sizeof(double), no_edges)) ==
-           MAP_FAILED)
-    ++err;
-  else if ((danglings = (int *)mmap_data(danglings_p, sizeof(int),
-                                         no_danglings)) == MAP_FAILED)
-    ++err;
-
-  if (err != 0) {
-    fprintf(stderr, " [ERROR] Data could not be mmapped from memory.\n");
-    fprintf(stderr,
-            "         Data is corrupted, the folder will be destroyed.\n");
-    delete_folder(dir);
-    /* Un-mmapping mmapped files */
-    if (row_ptr == MAP_FAILED) munmap(row_ptr, (no_nodes + 1) * sizeof(int));
-    if (col_ind == MAP_FAILED) munmap(col_ind, no_edges * sizeof(int));
-    if (val == MAP_FAILED) munmap(val, no_edges * sizeof(double));
-    if (danglings == MAP_FAILED) munmap(danglings, no_danglings * sizeof(int));
-    exit(EXIT_FAILURE);
+  flags = (verify ? IRWS_VERIFY : 0) | (compressed ? IRWS_COMPRESSED : 0) |
+          (tiled ? IRWS_TILED : 0);
+  if (pr_open(&g, dir, flags, no_threads) == EXIT_FAILURE) {
+    /* A rebuild would silently drop every delta merged so far, not only
+     * this one */
+    if (delta_p[0] != '\0') {
+      fprintf(stderr,
+              " [ERROR] Cannot open \"%s\" after the update, rebuild it "
+              "from an edge list that includes the merged deltas\n",
+              dir);
+      exit(EXIT_FAILURE);
+    }
+    fprintf(stderr, "         Rebuilding \"%s\"...\n", dir);
+    if (pr_build(dataset, dir, order_method, no_threads, 1) == EXIT_FAILURE ||
+        pr_open(&g, dir, flags, no_threads) == EXIT_FAILURE)
+      exit(EXIT_FAILURE);
   }
-
+  printf("no_nodes: %d\nno_edges: %ld\nno_danglings: %d\n", g.no_nodes,
+         (long)g.no_edges, g.no_danglings);
   printf("Done.\n\n");
 
 #ifdef DEBUG
   printf("CSR Transposed matrix\n");
   printf("---------------------\n");
-  printf("val:     [ ");
-  for (i = 0; i < no_edges; ++i) printf("%.3f ", val[i]);
+  printf("inv_out_deg: [ ");
+  for (i = 0; i < g.no_nodes; ++i) printf("%.3f ", g.inv_out_deg[i]);
   printf("]\n");
 
   printf("col_ind: [ ");
-  for (i = 0; i < no_edges; ++i) printf("%d ", col_ind[i]);
+  for (i = 0; i < g.no_edges; ++i) printf("%d ", g.col_ind[i]);
   printf("]\n");
 
   printf("row_ptr: [ ");
-  for (i = 0; i < no_nodes + 1; ++i) printf("%d ", row_ptr[i]);
+  for (i = 0; i < g.no_nodes + 1; ++i) printf("%ld ", (long)g.row_ptr[i]);
   printf("]\n\n");
   printf("danglings: [ ");
-  for (j = 0; j < no_danglings; ++j) {
-    printf("%d", danglings[j]);
-    if (j < no_danglings - 1) printf(", ");
+  for (j = 0; j < g.no_danglings; ++j) {
+    printf("%d", g.danglings[j]);
+    if (j < g.no_danglings - 1) printf(", ");
   }
   printf(" ]\n");
-  printf("Number of danglings nodes: %d\n\n", no_danglings);
+  printf("Number of danglings nodes: %d\n\n", g.no_danglings);
 #endif
 
-  /* Setting data up for PageRank computation */
-  p = (double *)malloc(sizeof(double) * no_nodes);
-  for (i = 0; i < no_nodes; ++i) p[i] = 1. / (double)no_nodes;
-  p_new = (double *)malloc(sizeof(double) * no_nodes);
-
-  compute_pagerank();
-
-  /* un-mmapping data */
-  munmap(row_ptr, (no_nodes + 1) * sizeof(int));
-  munmap(col_ind, no_edges * sizeof(int));
-  munmap(val, no_edges * sizeof(double));
-  munmap(col_ind, no_nodes * sizeof(int));
-
-  /* Writing data back to memory */
-  err = (write_data(fres, (void *)p, sizeof(double), no_nodes) == EXIT_FAILURE);
-
-  /* Vectors of probability */
-  free(p);
-  free(p_new);
-
-  /* Manage error from writing data to memory */
-  if (err) {
-    fprintf(stderr,
-            " [ERROR] PageRank result could not be written in memory.\n");
-    exit(EXIT_FAILURE);
+  if (query_node >= 0) {
+    err = query_push(&g);
+    pr_close(&g);
+    return err ? EXIT_FAILURE : EXIT_SUCCESS;
   }
 
-  return EXIT_SUCCESS;
-}
-
-void perform_compression(const char dataset_path[FNAME]) {
-  /* Reading data from input file */
-  FILE *pf;
-  char *s = NULL;
-  size_t slen = 0;
-  ssize_t bytes;
-  int ri, ci;
-  int *from, *to;
-  int f, t;
-  int i, j;
-  int *out_links;
-  int err;
-
-  /* Time elapsed data */
-  clock_t begin;
-  double elapsed_time;
-
-  printf(
-      "Input file data \"%s\" is not compressed, ready to perform "
-      "compression...\n\n",
-      dataset_path);
-  begin = clock();
-  mkdir(dir, 0700);
-
-  if ((pf = fopen(dataset_path, "r")) == NULL) {
-    fprintf(stderr, " [ERROR] Cannot open input file \"%s\"\n", dataset_path);
-    exit(EXIT_FAILURE);
+  if (seeds_p[0] != '\0') {
+    err = compute_ppr(g.row_ptr, g.col_ind, g.row_off, g.col_vb,
+                      g.inv_out_deg, g.danglings, g.no_danglings, g.no_nodes,
+                      g.perm, seeds_p, fppr, batch, no_threads) ==
+          EXIT_FAILURE;
+    pr_close(&g);
+    return err ? EXIT_FAILURE : EXIT_SUCCESS;
   }
 
-  /* Parsing input file header */
-  printf("Parsing input data...\n");
-  bytes = getline(&s, &slen, pf);
-  bytes = getline(&s, &slen, pf);
-  bytes = getline(&s, &slen, pf);
-  sscanf(s, "# Nodes: %d Edges: %d", &no_nodes, &no_edges);
-  printf("This graph has %d nodes and %d edges\n", no_nodes, no_edges);
-  bytes = getline(&s, &slen, pf);
-
-  csr_data.no_nodes = no_nodes;
-  csr_data.no_edges = no_edges;
-
-  /* Reading data from input file */
-  i = 0;
-  from = (int *)malloc(sizeof(int) * no_edges);
-  to = (int *)malloc(sizeof(int) * no_edges);
-  out_links = (int *)calloc(no_nodes, sizeof(int));
-  while ((bytes = getline(&s, &slen, pf)) != -1) {
-    sscanf(s, "%d %d", from + i, to + i);
-    out_links[from[i]] += 1;
-    if (i % 10 == 0) printf("\rEdge %d/%d", i, no_edges);
-    ++i;
+  pr_opt.solver = solver;
+  pr_opt.no_threads = no_threads;
+  pr_opt.verbose = 1;
+  pr_opt.numa = numa;
+
+  /* Out of core, neither the scores nor the matrix are ever held in memory
+   * at once. The result is written directly and starts from scratch */
+  if (mem_mb > 0) {
+    if (ref_dir[0] != '\0') printf("\"-r\" is ignored with \"-m\"\n\n");
+    if (numa) printf("\"-n\" is ignored with \"-m\"\n\n");
+    if (rank_K > 0) printf("\"--top\" is ignored with \"-m\"\n\n");
+    err = pr_solve_blocked(&g, &pr_opt, (size_t)mem_mb << 20, fres, NULL) ==
+          EXIT_FAILURE;
+    pr_close(&g);
+    if (err) {
+      fprintf(stderr,
+              " [ERROR] PageRank result could not be computed or written.\n");
+      exit(EXIT_FAILURE);
+    }
+    return EXIT_SUCCESS;
   }
-  printf("\rEdge %d/%d\n", i, no_edges);
-  printf("Done\n\n");
-  fclose(pf);
-  free(s);
-
-  /* Keeping track of danglings data */
-  no_danglings = 0;
-  for (i = 0; i < no_nodes; ++i)
-    if (out_links[i] == 0) ++no_danglings;
-  danglings = (int *)malloc(sizeof(int) * no_danglings);
-  j = 0;
-  for (i = 0; i < no_nodes; ++i)
-    if (out_links[i] == 0) danglings[j++] = i;
-
-  csr_data.no_danglings = no_danglings;
-
-  printf("Sorting edges...\n");
-  sort_input_data(from, to, no_edges);
-  printf("Done.\n\n");
 
-  /* csr matrix initialization */
-  val = (double *)malloc(sizeof(double) * no_edges);
-  col_ind = (int *)malloc(sizeof(int) * no_edges);
-  row_ptr = (int *)malloc(sizeof(int) * (no_nodes + 1));
-  ri = 0;
-  row_ptr[ri] = 0;
-  ci = 0;
-
-  /* Writing data in CSR matrix */
-  for (ci = 0; ci < no_edges; ++ci) {
-    f = from[ci];
-    t = to[ci];
-    if (t > ri) {
-      for (i = ri + 1; i <= t; ++i) row_ptr[i] = ci;
-      ri = t;
+  /* Setting data up for PageRank computation */
+  p = (real *)malloc(sizeof(real) * g.no_nodes);
+  for (i = 0; i < g.no_nodes; ++i) p[i] = 1. / (double)g.no_nodes;
+
+  /* After an update the previous result is a good first guess. New nodes
+   * keep the uniform value, and the whole vector is rescaled to sum 1 */
+  if (delta_p[0] != '\0') {
+    if ((i = read_scores(fres, p, g.no_nodes, g.perm)) > 0) {
+      double sum = 0.;
+
+      printf("Warm start from \"%s\" (%d nodes)\n\n", fres, i);
+      for (i = 0; i < g.no_nodes; ++i) sum += p[i];
+      for (i = 0; i < g.no_nodes; ++i) p[i] /= sum;
+    } else {
+      printf("No previous result in \"%s\", cold start\n\n", fres);
     }
-    val[ci] = 1. / (double)out_links[f];
-    col_ind[ci] = f;
   }
-  while (ri < no_nodes) row_ptr[++ri] = ci;
-
-  printf("CSR matrix filled\n");
-
-#ifdef DEBUG
-  printf("CSR Transposed matrix\n");
-  printf("---------------------\n");
-  printf("val:     [ ");
-  for (i = 0; i < no_edges; ++i) printf("%.3f ", val[i]);
-  printf("]\n");
 
-  printf("col_ind: [ ");
-  for (i = 0; i < no_edges; ++i) printf("%d ", col_ind[i]);
-  printf("]\n");
+  err = pr_solve(&g, &pr_opt, p, NULL) == EXIT_FAILURE;
 
-  printf("row_ptr: [ ");
-  for (i = 0; i < no_nodes + 1; ++i) printf("%d ", row_ptr[i]);
-  printf("]\n\n");
-  printf("danglings: [ ");
-  for (j = 0; j < no_danglings; ++j) {
-    printf("%d", danglings[j]);
-    if (j < no_danglings - 1) printf(", ");
+  /* Writing data back to memory */
+  err = err ||
+        (write_scores(fres, p, g.no_nodes, g.perm, "output") == EXIT_FAILURE);
+  if (!err && rank_K > 0) {
+    printf("Writing the top %d nodes to \"%s\" and \"%s\"\n", rank_K, ftop,
+           ftop_csv);
+    err = write_top_K(ftop, ftop_csv, p, g.no_nodes, g.perm, rank_K,
+                      no_threads, "top_k") == EXIT_FAILURE;
   }
-  printf(" ]\n");
-  printf("Number of danglings nodes: %d\n\n", no_danglings);
-#endif
 
-  /* Writing data back to memory */
-  err = (write_data(row_ptr_p, (void *)row_ptr, sizeof(int), no_nodes + 1) ==
-         EXIT_FAILURE) ||
-        (write_data(col_ind_p, (void *)col_ind, sizeof(int), no_edges) ==
-         EXIT_FAILURE) ||
-        (write_data(val_p, (void *)val, sizeof(double), no_edges) ==
-         EXIT_FAILURE) ||
-        (write_data(danglings_p, (void *)danglings, sizeof(int),
-                    no_danglings) == EXIT_FAILURE) ||
-        (write_data(csr_data_p, (void *)&csr_data, sizeof(CSR_data), 1) ==
-         EXIT_FAILURE);
-
-  /* Input data */
-  free(from);
-  free(to);
-  from = NULL;
-  to = NULL;
-  /* Danglings data */
-  free(out_links);
-  free(danglings);
-  out_links = NULL;
-  danglings = NULL;
-  /* CSR data structure */
-  free(val);
-  free(col_ind);
-  free(row_ptr);
-  val = NULL;
-  col_ind = NULL;
-  row_ptr = NULL;
+  if (!err && ref_dir[0] != '\0')
+    compare_scores(p, fref, g.no_nodes, g.perm, no_threads);
+  pr_close(&g);
+
+  /* Vector of probability */
+  free(p);
 
   /* Manage error from writing data to memory */
   if (err) {
-    delete_folder(dir);
-    fprintf(stderr, " [ERROR] Data could not be written in memory.\n");
+    fprintf(stderr,
+            " [ERROR] PageRank result could not be computed or written.\n");
     exit(EXIT_FAILURE);
   }
-  printf("Data written successfully!\n");
 
-  elapsed_time = (double)(clock() - begin) / CLOCKS_PER_SEC;
-  printf("Elapsed time: %.3fs\n\n", elapsed_time);
+  return EXIT_SUCCESS;
 }
 
-void compute_pagerank(void) {
-  double d = 0.85;
-  double dist = DBL_MAX;
-  int iter = 0;
-  double sum;
-  int ri, ci;
-  int i, j;
-
-  /* Time elapsed data */
-  clock_t begin, end;
-  double elapsed_time;
-
-  /* Computing PageRank */
-  printf("Computing PageRank...\n");
-  begin = clock();
-  while (dist > TOL && iter < MAX_ITER) {
-#ifdef DEBUG
-    if (iter % MOD_ITER == 0) {
-#endif
-      printf("\riter %d", iter);
-#ifdef DEBUG
-      printf("\n");
-      printf("p: ");
-      print_vec_f(p, no_nodes);
-    }
-#endif
+/* Answers a -q query. Returns non-zero on error */
+int query_push(const PR_graph *g) {
+  eidx *out_ptr = NULL;
+  int *out_ind = NULL;
+  int *ids = NULL, *inv;
+  int i;
+  int err = 0;
 
-    /* DTp = DanglingsT @ p */
-    danglings_dot_product = 0.;
-    for (j = 0; j < no_danglings; ++j) danglings_dot_product += p[danglings[j]];
-    danglings_dot_product /= (double)no_nodes;
+  if (query_node >= g->no_nodes) {
+    fprintf(stderr, " [ERROR] Node %d is not in the graph\n", query_node);
+    return 1;
+  }
+  if (load_transpose(out_ptr_p, out_ind_p, g->row_ptr, g->col_ind,
+                     g->no_nodes, cache_stamp(g->hdr), no_threads, &out_ptr,
+                     &out_ind) == EXIT_FAILURE) {
+    fprintf(stderr, " [ERROR] Out-links could not be loaded.\n");
+    return 1;
+  }
 
-    /* ATp = AT @ p + DTp */
-    for (ri = 0; ri < no_nodes; ++ri) {
-      p_new[ri] = danglings_dot_product;
-      for (ci = row_ptr[ri]; ci < row_ptr[ri + 1]; ++ci)
-        p_new[ri] += p[col_ind[ci]] * val[ci];
+  /* The inverse of perm is saved as well, so that a query does not cost a
+   * pass over all the nodes */
+  if (g->perm != NULL) {
+    if (!check_stamp(ids_p, sizeof(int) * (long)g->no_nodes,
+                     cache_stamp(g->hdr))) {
+      inv = (int *)malloc(sizeof(int) * g->no_nodes);
+      for (i = 0; i < g->no_nodes; ++i) inv[g->perm[i]] = i;
+      err = write_stamped(ids_p, inv, g->no_nodes, sizeof(int),
+                          cache_stamp(g->hdr)) == EXIT_FAILURE;
+      free(inv);
     }
-
-    /* d*AT @ p + (1-d)eeT @ p */
-    for (i = 0; i < no_nodes; ++i)
-      p_new[i] = d * p_new[i] + (1. - d) / (double)no_nodes;
-
-    dist = 0.;
-    for (i = 0; i < no_nodes; ++i)
-      dist += (p[i] - p_new[i]) * (p[i] - p_new[i]);
-    dist = sqrt(dist);
-
-    for (i = 0; i < no_nodes; ++i) p[i] = p_new[i];
-
-    ++iter;
+    if (err ||
+        (ids = (int *)mmap_data(ids_p, sizeof(int), g->no_nodes)) == NULL)
+      err = 1;
   }
-  end = clock();
-  printf("\riter %d\n", iter);
-#ifdef DEBUG
-  printf("p: ");
-  print_vec_f(p, no_nodes);
-#endif
-  printf("Done.\n\n");
 
-  sum = 0;
-  for (i = 0; i < no_nodes; ++i) sum += p[i];
-  printf("Proof of correctness:\n");
-  printf("sum(p) = %f\n\n", sum);
+  if (!err) {
+    printf("Local push from node %d (eps = %g)...\n", query_node, push_eps);
+    err = compute_push(out_ptr, out_ind, g->no_nodes, ids,
+                       g->perm != NULL ? g->perm[query_node] : query_node,
+                       push_eps, fpush) == EXIT_FAILURE;
+  }
 
-  elapsed_time = (double)(end - begin) / CLOCKS_PER_SEC;
-  printf("Elapsed time: %.3fs\n", elapsed_time);
+  munmap(out_ind, out_ptr[g->no_nodes] * sizeof(int));
+  munmap(out_ptr, (g->no_nodes + 1) * sizeof(eidx));
+  if (ids != NULL) munmap(ids, g->no_nodes * sizeof(int));
+  return err;
 }
@@ -0,0 +1,241 @@
+#include <float.h>
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ppr.h"
+#include "utils.h"
+
+#define DAMPING 0.85
+
+/* Reads one seed set per line, as whitespace separated node ids of the
+ * input file. The sets are returned in CSR form: set s holds the nodes
+ * set_nodes[set_ptr[s]] ... set_nodes[set_ptr[s + 1] - 1] */
+static int read_seed_sets(const char *path, int no_nodes, const int *perm,
+                          int *no_sets, int **set_ptr, int **set_nodes) {
+  FILE *pf;
+  char *s = NULL, *c, *end;
+  size_t slen = 0;
+  int cap_sets = 64, cap_nodes = 256;
+  int n = 0, k;
+  long id;
+
+  if ((pf = fopen(path, "r")) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot open seed file \"%s\"\n", path);
+    return EXIT_FAILURE;
+  }
+
+  *no_sets = 0;
+  *set_ptr = (int *)malloc(sizeof(int) * (cap_sets + 1));
+  *set_nodes = (int *)malloc(sizeof(int) * cap_nodes);
+  (*set_ptr)[0] = 0;
+  while (getline(&s, &slen, pf) != -1) {
+    if (s[0] == '#') continue;
+    k = n;
+    for (c = s;; c = end) {
+      id = strtol(c, &end, 10);
+      if (end == c) break;
+      if (id < 0 || id >= no_nodes) {
+        fprintf(stderr, " [ERROR] Seed %ld is not a node of the graph\n", id);
+        fclose(pf);
+        free(s);
+        free(*set_ptr);
+        free(*set_nodes);
+        *set_ptr = *set_nodes = NULL;
+        return EXIT_FAILURE;
+      }
+      if (n == cap_nodes) {
+        cap_nodes *= 2;
+        *set_nodes = (int *)realloc(*set_nodes, sizeof(int) * cap_nodes);
+      }
+      (*set_nodes)[n++] = perm != NULL ? perm[id] : (int)id;
+    }
+    /* Blank lines are not seed sets */
+    if (n == k) continue;
+    if (*no_sets == cap_sets) {
+      cap_sets *= 2;
+      *set_ptr = (int *)realloc(*set_ptr, sizeof(int) * (cap_sets + 1));
+    }
+    (*set_ptr)[++*no_sets] = n;
+  }
+  fclose(pf);
+  free(s);
+  return EXIT_SUCCESS;
+}
+
+/* Personalized PageRank of a block of B seed sets at once. The score
+ * vectors are stored node-major (x[i * B + b]), so every column index
+ * read from the matrix is used for all the B vectors */
+static int ppr_block(const eidx *row_ptr, const int *col_ind,
+                     const long *row_off, const unsigned char *col_vb,
+                     const double *inv_out_deg, const int *danglings,
+                     int no_danglings, int no_nodes, const int *bounds,
+                     int no_threads, const int *seeds, const int *seed_ptr,
+                     int B, real *x, real *x_new, real *q) {
+  double dang[PPR_MAX_BATCH], dist[PPR_MAX_BATCH];
+  double max_dist = DBL_MAX;
+  double weight;
+  real *tmp;
+  int iter = 0;
+  int i, j, b, k, t;
+
+  /* Start from the teleport vectors */
+  memset(x, 0, sizeof(real) * no_nodes * B);
+  for (b = 0; b < B; ++b) {
+    weight = 1. / (double)(seed_ptr[b + 1] - seed_ptr[b]);
+    for (k = seed_ptr[b]; k < seed_ptr[b + 1]; ++k)
+      x[(size_t)seeds[k] * B + b] += weight;
+  }
+
+  while (max_dist > TOL && iter < MAX_ITER) {
+    /* Dangling mass of every vector, sent back to its seeds */
+    for (b = 0; b < B; ++b) dang[b] = 0.;
+#pragma omp parallel for private(b) reduction(+ : dang[:B]) \
+    num_threads(no_threads)
+    for (j = 0; j < no_danglings; ++j)
+      for (b = 0; b < B; ++b) dang[b] += x[(size_t)danglings[j] * B + b];
+
+#pragma omp parallel for private(b) num_threads(no_threads)
+    for (i = 0; i < no_nodes; ++i)
+      for (b = 0; b < B; ++b)
+        q[(size_t)i * B + b] = x[(size_t)i * B + b] * inv_out_deg[i];
+
+    /* X_new = d * AT @ Q, one pass over the matrix for the whole block */
+#pragma omp parallel for schedule(static, 1) private(b) num_threads(no_threads)
+    for (t = 0; t < no_threads; ++t) {
+      double acc[PPR_MAX_BATCH];
+      const unsigned char *s;
+      const real *qc;
+      eidx ci;
+      int ri, col, gap;
+
+      for (ri = bounds[t]; ri < bounds[t + 1]; ++ri) {
+        for (b = 0; b < B; ++b) acc[b] = 0.;
+        if (col_vb != NULL) {
+          s = col_vb + row_off[ri];
+          col = 0;
+          for (ci = row_ptr[ri]; ci < row_ptr[ri + 1]; ++ci) {
+            VB_NEXT(s, gap);
+            col += gap;
+            qc = q + (size_t)col * B;
+            for (b = 0; b < B; ++b) acc[b] += qc[b];
+          }
+        } else {
+          for (ci = row_ptr[ri]; ci < row_ptr[ri + 1]; ++ci) {
+            qc = q + (size_t)col_ind[ci] * B;
+            for (b = 0; b < B; ++b) acc[b] += qc[b];
+          }
+        }
+        for (b = 0; b < B; ++b)
+          x_new[(size_t)ri * B + b] = DAMPING * acc[b];
+      }
+    }
+
+    /* Teleport and dangling mass go to the seeds */
+    for (b = 0; b < B; ++b) {
+      weight = (DAMPING * dang[b] + 1. - DAMPING) /
+               (double)(seed_ptr[b + 1] - seed_ptr[b]);
+      for (k = seed_ptr[b]; k < seed_ptr[b + 1]; ++k)
+        x_new[(size_t)seeds[k] * B + b] += weight;
+    }
+
+    for (b = 0; b < B; ++b) dist[b] = 0.;
+#pragma omp parallel for private(b) reduction(+ : dist[:B]) \
+    num_threads(no_threads)
+    for (i = 0; i < no_nodes; ++i) {
+      for (b = 0; b < B; ++b) {
+        double diff =
+            (double)x[(size_t)i * B + b] - x_new[(size_t)i * B + b];
+        dist[b] += diff * diff;
+      }
+    }
+    max_dist = 0.;
+    for (b = 0; b < B; ++b)
+      if (sqrt(dist[b]) > max_dist) max_dist = sqrt(dist[b]);
+
+    tmp = x;
+    x = x_new;
+    x_new = tmp;
+    ++iter;
+  }
+
+  /* The result must end up in the caller's x */
+  if (iter % 2 == 1) memcpy(x_new, x, sizeof(real) * no_nodes * B);
+  return iter;
+}
+
+int compute_ppr(const eidx *row_ptr, const int *col_ind, const long *row_off,
+                const unsigned char *col_vb, const double *inv_out_deg,
+                const int *danglings, int no_danglings, int no_nodes,
+                const int *perm, const char *seeds_path, const char *out_path,
+                int batch, int no_threads) {
+  FILE *pf;
+  int *set_ptr = NULL, *set_nodes = NULL;
+  int *bounds;
+  real *x, *x_new, *q;
+  float *row;
+  int no_sets;
+  int first, B, iter;
+  int i, b;
+  int err = 0;
+  double begin;
+
+  if (read_seed_sets(seeds_path, no_nodes, perm, &no_sets, &set_ptr,
+                     &set_nodes) == EXIT_FAILURE)
+    return EXIT_FAILURE;
+  if (batch > PPR_MAX_BATCH) batch = PPR_MAX_BATCH;
+
+  if ((pf = fopen(out_path, "wb")) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot create file \"%s\"\n", out_path);
+    free(set_ptr);
+    free(set_nodes);
+    return EXIT_FAILURE;
+  }
+  err = fwrite(&no_sets, sizeof(int), 1, pf) != 1 ||
+        fwrite(&no_nodes, sizeof(int), 1, pf) != 1;
+
+  bounds = (int *)malloc(sizeof(int) * (no_threads + 1));
+  partition_rows(row_ptr, no_nodes, no_threads, bounds);
+  x = (real *)malloc(sizeof(real) * no_nodes * batch);
+  x_new = (real *)malloc(sizeof(real) * no_nodes * batch);
+  q = (real *)malloc(sizeof(real) * no_nodes * batch);
+  row = (float *)malloc(sizeof(float) * no_nodes);
+
+  printf("Computing personalized PageRank of %d seed sets, %d at a time...\n",
+         no_sets, batch);
+  for (first = 0; first < no_sets && !err; first += B) {
+    B = no_sets - first < batch ? no_sets - first : batch;
+    begin = omp_get_wtime();
+    iter = ppr_block(row_ptr, col_ind, row_off, col_vb, inv_out_deg,
+                     danglings, no_danglings, no_nodes, bounds, no_threads,
+                     set_nodes, set_ptr + first, B, x, x_new, q);
+    printf("Sets %d-%d: %d iterations, %.3fs\n", first, first + B - 1, iter,
+           omp_get_wtime() - begin);
+
+    /* One row of floats per seed set, in the node order of the input */
+    for (b = 0; b < B && !err; ++b) {
+      for (i = 0; i < no_nodes; ++i)
+        row[i] = (float)x[(size_t)(perm != NULL ? perm[i] : i) * B + b];
+      err = fwrite(row, sizeof(float), no_nodes, pf) != (size_t)no_nodes;
+    }
+  }
+  err = fclose(pf) != 0 || err;
+
+  free(bounds);
+  free(x);
+  free(x_new);
+  free(q);
+  free(row);
+  free(set_ptr);
+  free(set_nodes);
+
+  if (err) {
+    fprintf(stderr, " [ERROR] Cannot write file \"%s\"\n", out_path);
+    remove(out_path);
+    return EXIT_FAILURE;
+  }
+  printf("Done.\n\n");
+  return EXIT_SUCCESS;
+}
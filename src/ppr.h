@@ -0,0 +1,15 @@
+#ifndef PPR_H
+#define PPR_H
+
+#include "utils.h"
+
+#define PPR_BATCH 16
+#define PPR_MAX_BATCH 64
+
+int compute_ppr(const eidx *row_ptr, const int *col_ind, const long *row_off,
+                const unsigned char *col_vb, const double *inv_out_deg,
+                const int *danglings, int no_danglings, int no_nodes,
+                const int *perm, const char *seeds_path, const char *out_path,
+                int batch, int no_threads);
+
+#endif
@@ -0,0 +1,1287 @@
+#include <float.h>
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#ifdef NUMA
+#include <numa.h>
+#endif
+
+#include "blocks.h"
+#include "irws.h"
+#include "metrics.h"
+
+#define DAMPING 0.85
+#define EXTRAP_ITER 10
+/* Iterations of the adaptive solver between two full sweeps */
+#define ADAPT_CHECK 10
+
+/* Sections of the cache file */
+#define SEC_ROW_PTR 0
+#define SEC_COL_IND 1
+#define SEC_INV_OUT_DEG 2
+#define SEC_DANGLINGS 3
+#define SEC_PERM 4
+#define NO_SECTIONS 5
+
+/* State of one PageRank solve. p and p_new are work vectors owned by the
+ * solve, the solvers swap them freely */
+typedef struct {
+  const PR_graph *g;
+  int no_threads;
+  int verbose;
+  int *bounds;
+  double dang;
+  real *p, *p_new;
+  /* NUMA mode: number of nodes used, and the copy of the graph whose
+   * arrays are placed on the node of the threads owning their rows. g then
+   * points to it */
+  int no_numa;
+  PR_graph local;
+  /* Tiled kernel: the cuts of the tiles along bounds, and the products of
+   * the rows, computed by every thread for its rows before using them */
+  eidx *cuts;
+  double *acc;
+  /* Start of the current iteration, and the edges and bytes one product
+   * processes */
+  Metrics_mark iter_mark;
+  double iter_edges, iter_bytes;
+} PR_ctx;
+
+/* Path of the file name in the cache directory dir */
+static void cache_path(char *path, const char *dir, const char *name) {
+  strcpy(path, dir);
+  strcat(path, name);
+}
+
+/* Writes the cache file of dir. hdr holds the source stamp and the sizes,
+ * perm may be NULL */
+static int write_pr_cache(const char *dir, Cache_header *hdr,
+                          const eidx *row_ptr, const int *col_ind,
+                          const double *inv_out_deg, const int *danglings,
+                          const int *perm, int no_threads) {
+  char path[DNAME + FNAME];
+  const void *data[NO_SECTIONS];
+
+  hdr->no_sections = NO_SECTIONS;
+  data[SEC_ROW_PTR] = row_ptr;
+  hdr->section[SEC_ROW_PTR].size = sizeof(eidx) * (hdr->no_nodes + 1L);
+  data[SEC_COL_IND] = col_ind;
+  hdr->section[SEC_COL_IND].size = sizeof(int) * hdr->no_edges;
+  data[SEC_INV_OUT_DEG] = inv_out_deg;
+  hdr->section[SEC_INV_OUT_DEG].size = sizeof(double) * (long)hdr->no_nodes;
+  data[SEC_DANGLINGS] = danglings;
+  hdr->section[SEC_DANGLINGS].size = sizeof(int) * (long)hdr->no_danglings;
+  data[SEC_PERM] = perm;
+  hdr->section[SEC_PERM].size =
+      perm != NULL ? sizeof(int) * (long)hdr->no_nodes : 0;
+  cache_path(path, dir, CACHE_FILE);
+  return write_cache(path, hdr, data, no_threads);
+}
+
+/* Whether the sections of hdr have the sizes its counts give them in a
+ * PageRank cache, and row_ptr spans no_edges entries */
+static int pr_sections(const Cache_header *hdr) {
+  const Cache_section *s = hdr->section;
+  const eidx *row_ptr;
+  long n = hdr->no_nodes;
+
+  if (hdr->no_sections != NO_SECTIONS ||
+      s[SEC_ROW_PTR].size != (long)sizeof(eidx) * (n + 1) ||
+      s[SEC_COL_IND].size != (long)sizeof(int) * hdr->no_edges ||
+      s[SEC_INV_OUT_DEG].size != (long)sizeof(double) * n ||
+      s[SEC_DANGLINGS].size != (long)sizeof(int) * hdr->no_danglings ||
+      (s[SEC_PERM].size != 0 && s[SEC_PERM].size != (long)sizeof(int) * n))
+    return 0;
+  row_ptr = (const eidx *)((const char *)hdr + s[SEC_ROW_PTR].offset);
+  return row_ptr[0] == 0 && row_ptr[n] == hdr->no_edges;
+}
+
+/* Builds the cache of the edge list dataset in dir, replacing whatever
+ * dir held */
+int pr_build(const char *dataset, const char *dir, const char *order,
+             int no_threads, int verbose) {
+  Cache_header hdr;
+  int *from, *to;
+  int *perm = NULL;
+  int *out_links, *danglings;
+  eidx *row_ptr;
+  int *col_ind;
+  double *inv_out_deg;
+  int no_nodes, no_danglings;
+  eidx no_edges, e;
+  int i, j;
+  int err;
+
+  /* Time elapsed data */
+  Metrics_mark begin, m;
+  double elapsed_time;
+
+  if (verbose)
+    printf(
+        "Input file data \"%s\" is not compressed, ready to perform "
+        "compression...\n\n",
+        dataset);
+  metrics_mark(&begin);
+
+  /* Reading data from input file */
+  if (verbose) printf("Parsing input data...\n");
+  if (read_edge_list(dataset, no_threads, &no_nodes, &no_edges, &from, &to) ==
+      EXIT_FAILURE)
+    return EXIT_FAILURE;
+  metrics_phase("parse", &begin);
+  if (verbose) {
+    printf("This graph has %d nodes and %ld edges\n", no_nodes,
+           (long)no_edges);
+    printf("Done\n\n");
+  }
+
+  if (order != NULL && order[0] != '\0') {
+    if (verbose) printf("Reordering nodes (%s)...\n", order);
+    metrics_mark(&m);
+    if ((perm = reorder_nodes(from, to, no_nodes, no_edges, order,
+                              no_threads)) == NULL) {
+      free(from);
+      free(to);
+      return EXIT_FAILURE;
+    }
+    metrics_phase("reorder", &m);
+    if (verbose) printf("Done.\n\n");
+  }
+  if (access(dir, F_OK) == 0) delete_folder(dir);
+  mkdir(dir, 0700);
+
+  init_cache_header(&hdr, dataset);
+  hdr.no_nodes = no_nodes;
+  hdr.no_edges = no_edges;
+
+  metrics_mark(&m);
+  out_links = (int *)calloc(no_nodes, sizeof(int));
+  for (e = 0; e < no_edges; ++e) out_links[from[e]] += 1;
+
+  /* Keeping track of danglings data */
+  no_danglings = 0;
+  for (i = 0; i < no_nodes; ++i)
+    if (out_links[i] == 0) ++no_danglings;
+  danglings = (int *)malloc(sizeof(int) * no_danglings);
+  j = 0;
+  for (i = 0; i < no_nodes; ++i)
+    if (out_links[i] == 0) danglings[j++] = i;
+
+  hdr.no_danglings = no_danglings;
+
+  /* csr matrix initialization */
+  inv_out_deg = (double *)malloc(sizeof(double) * no_nodes);
+  col_ind = (int *)malloc(sizeof(int) * (size_t)no_edges);
+  row_ptr = (eidx *)malloc(sizeof(eidx) * (no_nodes + 1));
+
+  /* Writing data in CSR matrix: row t of AT holds the sources of the edges
+   * pointing to t */
+  if (verbose) printf("Building CSR matrix...\n");
+  build_csr(to, from, no_nodes, no_edges, 0, no_threads, row_ptr, col_ind);
+  for (i = 0; i < no_nodes; ++i)
+    inv_out_deg[i] = out_links[i] > 0 ? 1. / (double)out_links[i] : 0.;
+  metrics_phase("csr", &m);
+
+  if (verbose) printf("CSR matrix filled\n");
+
+#ifdef DEBUG
+  printf("CSR Transposed matrix\n");
+  printf("---------------------\n");
+  printf("inv_out_deg: [ ");
+  for (i = 0; i < no_nodes; ++i) printf("%.3f ", inv_out_deg[i]);
+  printf("]\n");
+
+  printf("col_ind: [ ");
+  for (e = 0; e < no_edges; ++e) printf("%d ", col_ind[e]);
+  printf("]\n");
+
+  printf("row_ptr: [ ");
+  for (i = 0; i < no_nodes + 1; ++i) printf("%ld ", (long)row_ptr[i]);
+  printf("]\n\n");
+  printf("danglings: [ ");
+  for (j = 0; j < no_danglings; ++j) {
+    printf("%d", danglings[j]);
+    if (j < no_danglings - 1) printf(", ");
+  }
+  printf(" ]\n");
+  printf("Number of danglings nodes: %d\n\n", no_danglings);
+#endif
+
+  /* Writing data back to memory */
+  metrics_mark(&m);
+  err = write_pr_cache(dir, &hdr, row_ptr, col_ind, inv_out_deg, danglings,
+                       perm, no_threads) == EXIT_FAILURE;
+  metrics_phase("write", &m);
+
+  free(from);
+  free(to);
+  free(perm);
+  free(out_links);
+  free(danglings);
+  free(inv_out_deg);
+  free(col_ind);
+  free(row_ptr);
+
+  /* Manage error from writing data to memory */
+  if (err) {
+    delete_folder(dir);
+    fprintf(stderr, " [ERROR] Data could not be written in memory.\n");
+    return EXIT_FAILURE;
+  }
+
+  elapsed_time = metrics_phase("build", &begin);
+  if (verbose) {
+    printf("Data written successfully!\n");
+    printf("Elapsed time: %.3fs\n\n", elapsed_time);
+  }
+  return EXIT_SUCCESS;
+}
+
+/* Merges the edge delta in delta into the cache: AT is rebuilt row by row
+ * from the old one, and only the out-degrees of the sources of the changed
+ * edges are recomputed. The files derived from AT are removed, they are
+ * rebuilt the next time they are needed */
+int pr_update(const char *dir, const char *delta, int no_threads,
+              int verbose) {
+  char path[DNAME + FNAME];
+  char out_ptr_p[DNAME + FNAME], out_ind_p[DNAME + FNAME];
+  PR_graph g;
+  Cache_header hdr;
+  int *ins_from, *ins_to, *del_from, *del_to;
+  int no_ins, no_del;
+  eidx *new_ptr, *out_ptr = NULL, *new_out_ptr = NULL;
+  int *new_ind, *new_perm = NULL;
+  int *out_ind = NULL, *new_out_ind = NULL;
+  double *new_inv;
+  int *deg_delta, *danglings;
+  int new_nodes, no_danglings;
+  eidx new_edges;
+  int deg;
+  int i, j;
+  unsigned long stamp;
+  int err;
+
+  /* Time elapsed data */
+  Metrics_mark begin;
+  double elapsed_time;
+
+  if (verbose) printf("Updating \"%s\" with \"%s\"...\n", dir, delta);
+  metrics_mark(&begin);
+
+  if (pr_open(&g, dir, IRWS_VERIFY | IRWS_SEQUENTIAL, no_threads) ==
+      EXIT_FAILURE)
+    return EXIT_FAILURE;
+
+  /* A delta merged twice would duplicate its edges */
+  stamp = file_stamp(delta, no_threads);
+  if (delta_applied(g.hdr, stamp)) {
+    fprintf(stderr, " [ERROR] \"%s\" was already merged into \"%s\"\n",
+            delta, dir);
+    pr_close(&g);
+    return EXIT_FAILURE;
+  }
+
+  new_nodes = g.no_nodes;
+  if (read_edge_delta(delta, g.perm, &new_nodes, &no_ins, &ins_from, &ins_to,
+                      &no_del, &del_from, &del_to) == EXIT_FAILURE) {
+    pr_close(&g);
+    return EXIT_FAILURE;
+  }
+
+  /* Row t of AT holds the sources of the edges pointing to t */
+  new_edges = merge_csr(g.row_ptr, g.col_ind, g.no_nodes, new_nodes, ins_to,
+                        ins_from, no_ins, del_to, del_from, &no_del, 0,
+                        no_threads, &new_ptr, &new_ind);
+  if (verbose)
+    printf("%d edges inserted, %d deleted, %d new nodes\n", no_ins, no_del,
+           new_nodes - g.no_nodes);
+
+  /* The out-links, if a query stored them, are updated the same way */
+  cache_path(out_ptr_p, dir, "out_ptr.bin");
+  cache_path(out_ind_p, dir, "out_ind.bin");
+  if (check_stamp(out_ptr_p, sizeof(eidx) * (g.no_nodes + 1L),
+                  cache_stamp(g.hdr)) &&
+      (out_ptr = (eidx *)mmap_data(out_ptr_p, sizeof(eidx),
+                                   g.no_nodes + 1)) != NULL &&
+      (out_ind = (int *)mmap_data(out_ind_p, sizeof(int), g.no_edges)) !=
+          NULL) {
+    merge_csr(out_ptr, out_ind, g.no_nodes, new_nodes, ins_from, ins_to,
+              no_ins, del_from, del_to, &no_del, 1, no_threads, &new_out_ptr,
+              &new_out_ind);
+    munmap(out_ind, g.no_edges * sizeof(int));
+  }
+  if (out_ptr != NULL) munmap(out_ptr, (g.no_nodes + 1) * sizeof(eidx));
+
+  /* Out-degrees are recovered from the stored inverses, only for the
+   * sources of the changed edges */
+  new_inv = (double *)malloc(sizeof(double) * new_nodes);
+  memcpy(new_inv, g.inv_out_deg, sizeof(double) * g.no_nodes);
+  for (i = g.no_nodes; i < new_nodes; ++i) new_inv[i] = 0.;
+  deg_delta = (int *)calloc(new_nodes, sizeof(int));
+  for (j = 0; j < no_ins; ++j) ++deg_delta[ins_from[j]];
+  for (j = 0; j < no_del; ++j) --deg_delta[del_from[j]];
+  for (i = 0; i < new_nodes; ++i) {
+    if (deg_delta[i] == 0) continue;
+    deg = new_inv[i] > 0. ? (int)(1. / new_inv[i] + 0.5) : 0;
+    deg += deg_delta[i];
+    new_inv[i] = deg > 0 ? 1. / (double)deg : 0.;
+  }
+  free(deg_delta);
+
+  no_danglings = 0;
+  for (i = 0; i < new_nodes; ++i)
+    if (new_inv[i] == 0.) ++no_danglings;
+  danglings =
+      (int *)malloc(sizeof(int) * (no_danglings > 0 ? no_danglings : 1));
+  j = 0;
+  for (i = 0; i < new_nodes; ++i)
+    if (new_inv[i] == 0.) danglings[j++] = i;
+
+  /* New nodes keep their ids */
+  if (g.perm != NULL) {
+    new_perm = (int *)malloc(sizeof(int) * new_nodes);
+    memcpy(new_perm, g.perm, sizeof(int) * g.no_nodes);
+    for (i = g.no_nodes; i < new_nodes; ++i) new_perm[i] = i;
+  }
+
+  /* The cache keeps the stamp of the input file it was built from, and
+   * records the delta */
+  init_cache_header(&hdr, NULL);
+  hdr.src_size = g.hdr->src_size;
+  hdr.src_mtime = g.hdr->src_mtime;
+  record_delta(&hdr, g.hdr, stamp);
+  hdr.no_nodes = new_nodes;
+  hdr.no_edges = new_edges;
+  hdr.no_danglings = no_danglings;
+  pr_close(&g);
+
+  cache_path(path, dir, "row_off.bin");
+  remove(path);
+  cache_path(path, dir, "col_ind.vb");
+  remove(path);
+  cache_path(path, dir, "ids.bin");
+  remove(path);
+  cache_path(path, dir, "blocks.bin");
+  remove(path);
+  cache_path(path, dir, "tiles.bin");
+  remove(path);
+  if (new_out_ptr == NULL) {
+    remove(out_ptr_p);
+    remove(out_ind_p);
+  }
+  err = write_pr_cache(dir, &hdr, new_ptr, new_ind, new_inv, danglings,
+                       new_perm, no_threads) == EXIT_FAILURE;
+  /* The out-links are derived from the cache: those that cannot be written
+   * are built again by the next query that needs them */
+  if (!err && new_out_ptr != NULL &&
+      (write_data(out_ind_p, (void *)new_out_ind, sizeof(int), new_edges) ==
+           EXIT_FAILURE ||
+       write_stamped(out_ptr_p, (void *)new_out_ptr, new_nodes + 1,
+                     sizeof(eidx), cache_stamp(&hdr)) == EXIT_FAILURE)) {
+    remove(out_ptr_p);
+    remove(out_ind_p);
+  }
+
+  free(ins_from);
+  free(ins_to);
+  free(del_from);
+  free(del_to);
+  free(new_ptr);
+  free(new_ind);
+  free(new_inv);
+  free(new_perm);
+  free(new_out_ptr);
+  free(new_out_ind);
+  free(danglings);
+
+  /* write_cache() leaves the previous cache in place when it fails, so it
+   * is still valid, only the delta is not merged */
+  if (err) {
+    fprintf(stderr, " [ERROR] \"%s\" could not be merged into \"%s\"\n",
+            delta, dir);
+    return EXIT_FAILURE;
+  }
+
+  elapsed_time = metrics_phase("update", &begin);
+  if (verbose) printf("Done.\nElapsed time: %.3fs\n\n", elapsed_time);
+  return EXIT_SUCCESS;
+}
+
+/* Maps the cache file of dir into g, with the IRWS_* flags. With
+ * IRWS_COMPRESSED, the compressed col_ind is built if needed and mapped as
+ * well */
+int pr_open(PR_graph *g, const char *dir, int flags, int no_threads) {
+  char path[DNAME + FNAME], path_vb[DNAME + FNAME];
+  const char *base;
+  int map_flags = 0;
+  Metrics_mark begin;
+
+  metrics_mark(&begin);
+  memset(g, 0, sizeof(PR_graph));
+  strncpy(g->dir, dir, DNAME - 1);
+
+  if (flags & IRWS_POPULATE) map_flags |= CACHE_POPULATE;
+  if (flags & IRWS_VERIFY) map_flags |= CACHE_VERIFY;
+  if (flags & IRWS_SEQUENTIAL) map_flags |= CACHE_SEQUENTIAL;
+  cache_path(path, dir, CACHE_FILE);
+  if ((g->hdr = map_cache(path, map_flags, no_threads, &g->map_len)) ==
+      NULL)
+    return EXIT_FAILURE;
+  if (!pr_sections(g->hdr)) {
+    fprintf(stderr, " [ERROR] \"%s\" is not a PageRank cache\n", path);
+    pr_close(g);
+    return EXIT_FAILURE;
+  }
+  g->no_nodes = g->hdr->no_nodes;
+  g->no_edges = g->hdr->no_edges;
+  g->no_danglings = g->hdr->no_danglings;
+
+  base = (const char *)g->hdr;
+  g->row_ptr = (eidx *)(base + g->hdr->section[SEC_ROW_PTR].offset);
+  g->col_ind = (int *)(base + g->hdr->section[SEC_COL_IND].offset);
+  g->inv_out_deg = (double *)(base + g->hdr->section[SEC_INV_OUT_DEG].offset);
+  if (g->no_danglings > 0)
+    g->danglings = (int *)(base + g->hdr->section[SEC_DANGLINGS].offset);
+  if (g->hdr->section[SEC_PERM].size > 0)
+    g->perm = (int *)(base + g->hdr->section[SEC_PERM].offset);
+
+  cache_path(path, dir, "row_off.bin");
+  cache_path(path_vb, dir, "col_ind.vb");
+  if ((flags & IRWS_COMPRESSED) &&
+      load_vb_csr(path, path_vb, g->row_ptr, g->col_ind, g->no_nodes,
+                  cache_stamp(g->hdr), &g->row_off,
+                  &g->col_vb) == EXIT_FAILURE) {
+    fprintf(stderr, " [ERROR] Data could not be mmapped from memory.\n");
+    pr_close(g);
+    return EXIT_FAILURE;
+  }
+  cache_path(path, dir, "tiles.bin");
+  if ((flags & IRWS_TILED) &&
+      load_tiles(path, g->hdr, g->row_ptr, g->col_ind, map_flags, no_threads,
+                 &g->tiles) == EXIT_FAILURE) {
+    fprintf(stderr, " [ERROR] Data could not be mmapped from memory.\n");
+    pr_close(g);
+    return EXIT_FAILURE;
+  }
+  metrics_phase("mmap", &begin);
+  return EXIT_SUCCESS;
+}
+
+void pr_close(PR_graph *g) {
+  close_tiles(&g->tiles);
+  if (g->row_off != NULL) {
+    if (g->col_vb != NULL) munmap(g->col_vb, g->row_off[g->no_nodes]);
+    munmap(g->row_off, (g->no_nodes + 1) * sizeof(long));
+  }
+  if (g->hdr != NULL) munmap((void *)g->hdr, g->map_len);
+  memset(g, 0, sizeof(PR_graph));
+}
+
+/* Sum of x over the non-zeros of row ri of AT */
+static double gather_row(PR_ctx *c, int ri, const real *x) {
+  const PR_graph *g = c->g;
+  const unsigned char *s;
+  double acc = 0.;
+  eidx ci;
+  int col, gap;
+
+  if (g->row_off != NULL) {
+    s = g->col_vb + g->row_off[ri];
+    col = 0;
+    for (ci = g->row_ptr[ri]; ci < g->row_ptr[ri + 1]; ++ci) {
+      VB_NEXT(s, gap);
+      col += gap;
+      acc += x[col];
+    }
+  } else {
+    for (ci = g->row_ptr[ri]; ci < g->row_ptr[ri + 1]; ++ci)
+      acc += x[g->col_ind[ci]];
+  }
+  return acc;
+}
+
+/* With the tiled kernel, c->acc = AT @ x over the rows of thread t, before
+ * they are used by row_product() */
+static void tile_rows(PR_ctx *c, int t, const real *x) {
+  int ri;
+
+  if (c->acc == NULL) return;
+  for (ri = c->bounds[t]; ri < c->bounds[t + 1]; ++ri) c->acc[ri] = 0.;
+  tile_product(&c->g->tiles, c->cuts, c->no_threads, t, x, c->acc);
+}
+
+static double row_product(PR_ctx *c, int ri, const real *x) {
+  return c->acc != NULL ? c->acc[ri] : gather_row(c, ri, x);
+}
+
+/* DTx = DanglingsT @ x, spread over all the nodes */
+static double dangling_sum(PR_ctx *c, const real *x) {
+  const PR_graph *g = c->g;
+  double sum = 0.;
+  int j;
+
+#pragma omp parallel for reduction(+ : sum) num_threads(c->no_threads)
+  for (j = 0; j < g->no_danglings; ++j) sum += x[g->danglings[j]];
+  return sum / (double)g->no_nodes;
+}
+
+/* q = x scaled by the inverse out-degrees, so that AT @ x is a plain
+ * gather-sum of q over g->col_ind */
+static void scale_by_out_deg(PR_ctx *c, const real *x, real *q) {
+  const PR_graph *g = c->g;
+  int i, t;
+
+  /* With NUMA placement, x and inv_out_deg are read where they live */
+  if (c->no_numa > 0) {
+#pragma omp parallel for schedule(static, 1) private(i) \
+    num_threads(c->no_threads)
+    for (t = 0; t < c->no_threads; ++t)
+      for (i = c->bounds[t]; i < c->bounds[t + 1]; ++i)
+        q[i] = x[i] * g->inv_out_deg[i];
+    return;
+  }
+#pragma omp parallel for num_threads(c->no_threads)
+  for (i = 0; i < g->no_nodes; ++i) q[i] = x[i] * g->inv_out_deg[i];
+}
+
+/* y = d*(AT @ x + DTx) + (1-d)eeT @ x, fused with the distance between x
+ * and y, which is returned */
+static double power_step(PR_ctx *c, const real *x, real *q, real *y) {
+  const PR_graph *g = c->g;
+  double teleport = (1. - DAMPING) / (double)g->no_nodes;
+  double dist = 0.;
+  int t;
+
+  c->dang = dangling_sum(c, x);
+  scale_by_out_deg(c, x, q);
+
+#pragma omp parallel for schedule(static, 1) reduction(+ : dist) \
+    num_threads(c->no_threads)
+  for (t = 0; t < c->no_threads; ++t) {
+    int ri;
+    double diff;
+
+    tile_rows(c, t, q);
+    for (ri = c->bounds[t]; ri < c->bounds[t + 1]; ++ri) {
+      y[ri] = DAMPING * (row_product(c, ri, q) + c->dang) + teleport;
+      diff = (double)x[ri] - y[ri];
+      dist += diff * diff;
+    }
+  }
+  return sqrt(dist);
+}
+
+/* y = x - d*(AT @ x + DTx), the matrix of the linear system solved by
+ * BiCGSTAB */
+static void apply_system(PR_ctx *c, const real *x, real *q, real *y) {
+  int t;
+
+  c->dang = dangling_sum(c, x);
+  scale_by_out_deg(c, x, q);
+
+#pragma omp parallel for schedule(static, 1) num_threads(c->no_threads)
+  for (t = 0; t < c->no_threads; ++t) {
+    int ri;
+
+    tile_rows(c, t, q);
+    for (ri = c->bounds[t]; ri < c->bounds[t + 1]; ++ri)
+      y[ri] = x[ri] - DAMPING * (row_product(c, ri, q) + c->dang);
+  }
+}
+
+static double dot(PR_ctx *c, const real *x, const real *y) {
+  const PR_graph *g = c->g;
+  double sum = 0.;
+  int i;
+
+#pragma omp parallel for reduction(+ : sum) num_threads(c->no_threads)
+  for (i = 0; i < g->no_nodes; ++i) sum += (double)x[i] * y[i];
+  return sum;
+}
+
+/* Rescales x so that it sums to 1 */
+static void normalize(PR_ctx *c, real *x) {
+  const PR_graph *g = c->g;
+  double sum = 0.;
+  int i;
+
+#pragma omp parallel for reduction(+ : sum) num_threads(c->no_threads)
+  for (i = 0; i < g->no_nodes; ++i) sum += x[i];
+#pragma omp parallel for num_threads(c->no_threads)
+  for (i = 0; i < g->no_nodes; ++i) x[i] /= sum;
+}
+
+/* Records iteration iter - 1, which is over, and starts iteration iter */
+static void mark_iter(PR_ctx *c, int iter) {
+  if (iter > 0)
+    metrics_iter("pagerank", iter - 1, &c->iter_mark, c->iter_edges,
+                 c->iter_bytes);
+  metrics_mark(&c->iter_mark);
+}
+
+/* Called at the start of every iteration */
+static void print_iter(PR_ctx *c, int iter) {
+  mark_iter(c, iter);
+  if (!c->verbose) return;
+#ifdef DEBUG
+  if (iter % MOD_ITER == 0) {
+#endif
+    printf("\riter %d", iter);
+#ifdef DEBUG
+    printf("\n");
+    printf("p: ");
+    print_vec_f(c->p, c->g->no_nodes);
+  }
+#endif
+}
+
+/* Plain power iteration */
+static int solve_jacobi(PR_ctx *c, real *q) {
+  double dist = DBL_MAX;
+  real *tmp;
+  int iter = 0;
+
+  while (dist > TOL && iter < MAX_ITER) {
+    print_iter(c, iter);
+    dist = power_step(c, c->p, q, c->p_new);
+    tmp = c->p;
+    c->p = c->p_new;
+    c->p_new = tmp;
+    ++iter;
+  }
+  return iter;
+}
+
+/* Power iteration with quadratic extrapolation (Kamvar et al.) every
+ * EXTRAP_ITER iterations: the last four iterates are combined to cancel the
+ * error along the two subdominant eigenvectors, which may be complex */
+static int solve_extrapolated(PR_ctx *c, real *q) {
+  const PR_graph *g = c->g;
+  double dist = DBL_MAX;
+  double a11, a12, a22, b1, b2, det;
+  double g1, g2, b0, b1_, y1, y2, y3;
+  /* x[0] is the oldest iterate, x[3] the newest. x[0] and x[1] start as
+   * malloc()ed buffers, c->p and c->p_new may be placed on NUMA nodes */
+  real *x[4];
+  real *p = c->p, *p_new = c->p_new;
+  real *tmp;
+  int iter = 0;
+  int i, k;
+
+  x[0] = (real *)malloc(sizeof(real) * g->no_nodes);
+  x[1] = (real *)malloc(sizeof(real) * g->no_nodes);
+  x[2] = c->p_new;
+  x[3] = c->p;
+  while (dist > TOL && iter < MAX_ITER) {
+    print_iter(c, iter);
+    tmp = x[0];
+    for (k = 0; k < 3; ++k) x[k] = x[k + 1];
+    dist = power_step(c, x[2], q, tmp);
+    x[3] = tmp;
+    ++iter;
+
+    if (iter >= 4 && iter % EXTRAP_ITER == 0 && dist > TOL) {
+      /* Least squares fit of y3 on y1, y2, with yj = x[j] - x[0] */
+      a11 = a12 = a22 = b1 = b2 = 0.;
+#pragma omp parallel for private(y1, y2, y3) \
+    reduction(+ : a11, a12, a22, b1, b2) num_threads(c->no_threads)
+      for (i = 0; i < g->no_nodes; ++i) {
+        y1 = (double)x[1][i] - x[0][i];
+        y2 = (double)x[2][i] - x[0][i];
+        y3 = (double)x[3][i] - x[0][i];
+        a11 += y1 * y1;
+        a12 += y1 * y2;
+        a22 += y2 * y2;
+        b1 -= y1 * y3;
+        b2 -= y2 * y3;
+      }
+      det = a11 * a22 - a12 * a12;
+      if (fabs(det) > DBL_MIN) {
+        g1 = (b1 * a22 - b2 * a12) / det;
+        g2 = (a11 * b2 - a12 * b1) / det;
+        b0 = g1 + g2 + 1.;
+        b1_ = g2 + 1.;
+#pragma omp parallel for num_threads(c->no_threads)
+        for (i = 0; i < g->no_nodes; ++i)
+          x[3][i] = b0 * x[1][i] + b1_ * x[2][i] + x[3][i];
+        normalize(c, x[3]);
+      }
+    }
+  }
+
+  /* The result goes back to c->p, so that every buffer is released by the
+   * allocator it comes from */
+  if (x[3] != p) {
+#pragma omp parallel for num_threads(c->no_threads)
+    for (i = 0; i < g->no_nodes; ++i) p[i] = x[3][i];
+  }
+  for (k = 0; k < 4; ++k)
+    if (x[k] != p && x[k] != p_new) free(x[k]);
+  return iter;
+}
+
+/* In-place sweeps that use the values already updated in the current one.
+ * The sweep is inherently sequential, so it runs on one thread */
+static int solve_gauss_seidel(PR_ctx *c, real *q) {
+  const PR_graph *g = c->g;
+  double teleport = (1. - DAMPING) / (double)g->no_nodes;
+  double dist = DBL_MAX;
+  double diff;
+  real next;
+  int iter = 0;
+  int ri;
+
+  scale_by_out_deg(c, c->p, q);
+  while (dist > TOL && iter < MAX_ITER) {
+    print_iter(c, iter);
+    c->dang = dangling_sum(c, c->p);
+    dist = 0.;
+    for (ri = 0; ri < g->no_nodes; ++ri) {
+      next = DAMPING * (gather_row(c, ri, q) + c->dang) + teleport;
+      diff = (double)next - c->p[ri];
+      dist += diff * diff;
+      c->p[ri] = next;
+      q[ri] = next * g->inv_out_deg[ri];
+    }
+    normalize(c, c->p);
+    scale_by_out_deg(c, c->p, q);
+    dist = sqrt(dist);
+    ++iter;
+  }
+  return iter;
+}
+
+/* Adaptive power iteration (Kamvar et al.): a node whose value changes by
+ * at most TOL/|p| of itself is frozen, so that the frozen nodes together
+ * move by at most TOL, and the following sweeps only update the active
+ * nodes, still gathering from all of them. Every ADAPT_CHECK iterations,
+ * or once the active nodes have settled, a full sweep updates every node,
+ * thaws those that moved and tests convergence, which only full sweeps
+ * do */
+static int solve_adaptive(PR_ctx *c, real *q) {
+  const PR_graph *g = c->g;
+  double teleport = (1. - DAMPING) / (double)g->no_nodes;
+  double dist = DBL_MAX;
+  double dang_diff, edges, freeze = 0.;
+  /* Active nodes of thread t, from active + bounds[t] */
+  int *active = (int *)malloc(sizeof(int) * g->no_nodes);
+  int *no_active = (int *)malloc(sizeof(int) * c->no_threads);
+  long rows = 0, updates = 0;
+  int full = 1;
+  int iter = 0;
+  int i, t;
+
+  scale_by_out_deg(c, c->p, q);
+  while (iter < MAX_ITER) {
+    print_iter(c, iter);
+    if (full) {
+      if (c->verbose && iter > 0)
+        printf("\riter %d: full sweep, %ld node(s) frozen\n", iter,
+               (long)g->no_nodes - rows);
+      c->dang = dangling_sum(c, c->p);
+      freeze = TOL / sqrt(dot(c, c->p, c->p));
+      for (t = 0; t < c->no_threads; ++t)
+        no_active[t] = c->bounds[t + 1] - c->bounds[t];
+#pragma omp parallel for num_threads(c->no_threads)
+      for (i = 0; i < g->no_nodes; ++i) active[i] = i;
+    }
+
+    /* New values of the active nodes, from q which holds all the current
+     * ones */
+    rows = 0;
+    dist = edges = 0.;
+#pragma omp parallel for schedule(static, 1) reduction(+ : dist, edges) \
+    num_threads(c->no_threads)
+    for (t = 0; t < c->no_threads; ++t) {
+      const int *a = active + c->bounds[t];
+      double diff;
+      int k, ri;
+
+      for (k = 0; k < no_active[t]; ++k) {
+        ri = a[k];
+        c->p_new[ri] = DAMPING * (gather_row(c, ri, q) + c->dang) + teleport;
+        diff = (double)c->p_new[ri] - c->p[ri];
+        dist += diff * diff;
+        edges += (double)(g->row_ptr[ri + 1] - g->row_ptr[ri]);
+      }
+    }
+
+    /* Once q is no longer read, the new values replace the current ones
+     * and the nodes that barely moved leave the active lists */
+    dang_diff = 0.;
+#pragma omp parallel for schedule(static, 1) reduction(+ : dang_diff, rows) \
+    num_threads(c->no_threads)
+    for (t = 0; t < c->no_threads; ++t) {
+      int *a = active + c->bounds[t];
+      double diff;
+      int k, ri, kept = 0;
+
+      for (k = 0; k < no_active[t]; ++k) {
+        ri = a[k];
+        diff = (double)c->p_new[ri] - c->p[ri];
+        if (g->inv_out_deg[ri] == 0.) dang_diff += diff;
+        if (fabs(diff) > freeze * c->p[ri]) a[kept++] = ri;
+        c->p[ri] = c->p_new[ri];
+        q[ri] = c->p[ri] * g->inv_out_deg[ri];
+      }
+      rows += no_active[t];
+      no_active[t] = kept;
+    }
+    c->dang += dang_diff / (double)g->no_nodes;
+    c->iter_edges = edges;
+    c->iter_bytes = spmv_bytes((int)rows, (eidx)edges);
+    updates += rows;
+    dist = sqrt(dist);
+    ++iter;
+    if (full && dist <= TOL) break;
+
+    /* rows is now the number of nodes left active */
+    rows = 0;
+    for (t = 0; t < c->no_threads; ++t) rows += no_active[t];
+    full = iter % ADAPT_CHECK == 0 || dist <= TOL || rows == 0;
+  }
+  normalize(c, c->p);
+  if (c->verbose)
+    printf("\rNode updates: %ld, %.1f%% of %d full sweeps\n", updates,
+           100. * (double)updates / ((double)g->no_nodes * iter), iter);
+
+  free(active);
+  free(no_active);
+  return iter;
+}
+
+/* BiCGSTAB on (I - d*(AT + DT)) p = (1-d)/n e. Every iteration costs two
+ * products with the matrix */
+static int solve_bicgstab(PR_ctx *c, real *q) {
+  const PR_graph *g = c->g;
+  real *r = (real *)malloc(sizeof(real) * g->no_nodes);
+  real *r0 = (real *)malloc(sizeof(real) * g->no_nodes);
+  real *dir_v = (real *)malloc(sizeof(real) * g->no_nodes);
+  real *v = c->p_new;
+  real *s = (real *)malloc(sizeof(real) * g->no_nodes);
+  real *t = (real *)malloc(sizeof(real) * g->no_nodes);
+  double teleport = (1. - DAMPING) / (double)g->no_nodes;
+  double rho = 1., rho_new, alpha = 1., omega = 1., beta;
+  double res = DBL_MAX;
+  int iter = 0;
+  int i;
+
+  /* r = b - M @ p */
+  apply_system(c, c->p, q, v);
+#pragma omp parallel for num_threads(c->no_threads)
+  for (i = 0; i < g->no_nodes; ++i) {
+    r[i] = teleport - v[i];
+    r0[i] = r[i];
+    dir_v[i] = 0.;
+    v[i] = 0.;
+  }
+  res = sqrt(dot(c, r, r));
+
+  while (res > TOL && iter < MAX_ITER) {
+    print_iter(c, iter);
+    rho_new = dot(c, r0, r);
+    beta = (rho_new / rho) * (alpha / omega);
+#pragma omp parallel for num_threads(c->no_threads)
+    for (i = 0; i < g->no_nodes; ++i)
+      dir_v[i] = r[i] + beta * (dir_v[i] - omega * v[i]);
+    apply_system(c, dir_v, q, v);
+    alpha = rho_new / dot(c, r0, v);
+#pragma omp parallel for num_threads(c->no_threads)
+    for (i = 0; i < g->no_nodes; ++i) s[i] = r[i] - alpha * v[i];
+    ++iter;
+
+    if (sqrt(dot(c, s, s)) <= TOL) {
+#pragma omp parallel for num_threads(c->no_threads)
+      for (i = 0; i < g->no_nodes; ++i) c->p[i] += alpha * dir_v[i];
+      break;
+    }
+
+    apply_system(c, s, q, t);
+    omega = dot(c, t, s) / dot(c, t, t);
+#pragma omp parallel for num_threads(c->no_threads)
+    for (i = 0; i < g->no_nodes; ++i) {
+      c->p[i] += alpha * dir_v[i] + omega * s[i];
+      r[i] = s[i] - omega * t[i];
+    }
+    res = sqrt(dot(c, r, r));
+    rho = rho_new;
+  }
+  normalize(c, c->p);
+
+  free(r);
+  free(r0);
+  free(dir_v);
+  free(s);
+  free(t);
+  return iter;
+}
+
+#ifdef NUMA
+/* Threads are split in contiguous groups, one per NUMA node, so that every
+ * node owns a contiguous range of rows */
+static int place_node_of(const PR_ctx *c, int t) {
+  return (int)((long)t * c->no_numa / c->no_threads);
+}
+
+static size_t place_len(size_t len) { return len > 0 ? len : 1; }
+
+/* Copy of the cut[no_threads] elements of elem bytes at src. Slice t,
+ * [cut[t], cut[t+1]), is bound to the node of thread t, which copies it.
+ * Pages shared by two slices go to the node of the last one */
+static void *place_copy(PR_ctx *c, const void *src, size_t elem,
+                       const long *cut) {
+  char *dst = (char *)numa_alloc(place_len(elem * cut[c->no_threads]));
+  char *lo;
+  long page = numa_pagesize();
+  int t;
+
+  for (t = 0; t < c->no_threads; ++t) {
+    if (cut[t + 1] == cut[t]) continue;
+    lo = dst + elem * cut[t] / page * page;
+    numa_tonode_memory(lo, dst + elem * cut[t + 1] - lo, place_node_of(c, t));
+  }
+#pragma omp parallel for schedule(static, 1) num_threads(c->no_threads)
+  for (t = 0; t < c->no_threads; ++t)
+    memcpy(dst + elem * cut[t], (const char *)src + elem * cut[t],
+           elem * (cut[t + 1] - cut[t]));
+  return dst;
+}
+
+/* Binds thread t to the node place_node_of(t), or every thread to all the
+ * nodes when unbind is set */
+static void place_bind(PR_ctx *c, int unbind) {
+  int t;
+
+#pragma omp parallel for schedule(static, 1) num_threads(c->no_threads)
+  for (t = 0; t < c->no_threads; ++t)
+    numa_run_on_node(unbind ? -1 : place_node_of(c, t));
+}
+
+/* Replaces the graph of c by local copies of its row_ptr, col_ind,
+ * inv_out_deg and compressed col_ind, and p and p_new by vectors, each
+ * split along c->bounds and placed on the node of the threads that own the
+ * rows. q is gathered from all the rows and interleaved instead */
+static int place_setup(PR_ctx *c, real **q) {
+  const PR_graph *g = c->g;
+  PR_graph *l = &c->local;
+  long *rows, *cols;
+  real *p;
+  int t;
+
+  if (numa_available() < 0) {
+    fprintf(stderr, " [ERROR] NUMA is not available on this system\n");
+    return EXIT_FAILURE;
+  }
+  c->no_numa = numa_num_configured_nodes();
+  if (c->no_numa > c->no_threads) c->no_numa = c->no_threads;
+  if (c->verbose)
+    printf("Placing rows and vectors on %d NUMA node(s)...\n", c->no_numa);
+  place_bind(c, 0);
+
+  rows = (long *)malloc(sizeof(long) * (c->no_threads + 1));
+  cols = (long *)malloc(sizeof(long) * (c->no_threads + 1));
+  *l = *g;
+  for (t = 0; t <= c->no_threads; ++t) {
+    rows[t] = c->bounds[t];
+    cols[t] = g->row_ptr[c->bounds[t]];
+  }
+  l->col_ind = (int *)place_copy(c, g->col_ind, sizeof(int), cols);
+  l->inv_out_deg = (double *)place_copy(c, g->inv_out_deg, sizeof(double),
+                                       rows);
+  if (g->row_off != NULL) {
+    for (t = 0; t <= c->no_threads; ++t)
+      cols[t] = g->row_off[c->bounds[t]];
+    l->col_vb = (unsigned char *)place_copy(c, g->col_vb, 1, cols);
+  }
+  ++rows[c->no_threads];
+  l->row_ptr = (eidx *)place_copy(c, g->row_ptr, sizeof(eidx), rows);
+  if (g->row_off != NULL)
+    l->row_off = (long *)place_copy(c, g->row_off, sizeof(long), rows);
+  --rows[c->no_threads];
+
+  p = c->p;
+  c->p = (real *)place_copy(c, p, sizeof(real), rows);
+  free(p);
+  free(c->p_new);
+  c->p_new = (real *)place_copy(c, c->p, sizeof(real), rows);
+  free(*q);
+  *q = (real *)numa_alloc_interleaved(place_len(sizeof(real) * g->no_nodes));
+  c->g = l;
+
+  free(rows);
+  free(cols);
+  return EXIT_SUCCESS;
+}
+
+static void place_teardown(PR_ctx *c, real *q) {
+  const PR_graph *l = &c->local;
+  size_t n = l->no_nodes;
+
+  place_bind(c, 1);
+  if (l->row_off != NULL) {
+    numa_free(l->col_vb, place_len(l->row_off[n]));
+    numa_free(l->row_off, place_len(sizeof(long) * (n + 1)));
+  }
+  numa_free(l->row_ptr, place_len(sizeof(eidx) * (n + 1)));
+  numa_free(l->col_ind, place_len(sizeof(int) * (size_t)l->no_edges));
+  numa_free(l->inv_out_deg, place_len(sizeof(double) * n));
+  numa_free(c->p, place_len(sizeof(real) * n));
+  numa_free(c->p_new, place_len(sizeof(real) * n));
+  numa_free(q, place_len(sizeof(real) * n));
+}
+#endif
+
+/* Solves PageRank on g, starting from p and leaving the result in it. The
+ * number of iterations goes to *iter when iter is not NULL */
+int pr_solve(const PR_graph *g, const PR_options *opt, real *p, int *iter) {
+  PR_ctx ctx, *c = &ctx;
+  const char *solver = opt->solver != NULL ? opt->solver : "jacobi";
+  int no_iter = 0;
+  double sum;
+  real *q;
+  int i;
+  int err = EXIT_SUCCESS;
+
+  /* Time elapsed data */
+  Metrics_mark begin;
+  double elapsed_time;
+
+  if (strcmp(solver, "jacobi") != 0 && strcmp(solver, "gs") != 0 &&
+      strcmp(solver, "extrap") != 0 && strcmp(solver, "bicgstab") != 0 &&
+      strcmp(solver, "adaptive") != 0) {
+    fprintf(stderr, " [ERROR] Unknown solver \"%s\"\n", solver);
+    return EXIT_FAILURE;
+  }
+
+  c->g = g;
+  c->no_threads = opt->no_threads > 0 ? opt->no_threads : 1;
+  c->verbose = opt->verbose;
+  c->dang = 0.;
+  c->no_numa = 0;
+  c->cuts = NULL;
+  c->acc = NULL;
+  c->p = (real *)malloc(sizeof(real) * g->no_nodes);
+  c->p_new = (real *)malloc(sizeof(real) * g->no_nodes);
+  memcpy(c->p, p, sizeof(real) * g->no_nodes);
+  q = (real *)malloc(sizeof(real) * g->no_nodes);
+
+  /* Rows are split by number of edges, not by number of rows, so that
+   * threads owning high in-degree nodes do not lag behind the others */
+  c->bounds = (int *)malloc(sizeof(int) * (c->no_threads + 1));
+  partition_rows(g->row_ptr, g->no_nodes, c->no_threads, c->bounds);
+
+  if (opt->numa) {
+#ifdef NUMA
+    err = place_setup(c, &q);
+#else
+    fprintf(stderr, " [ERROR] NUMA placement needs a build with "
+                    "\"make CFLAGS=-DNUMA\"\n");
+    err = EXIT_FAILURE;
+#endif
+    if (err == EXIT_FAILURE) {
+      free(c->bounds);
+      free(c->p);
+      free(c->p_new);
+      free(q);
+      return EXIT_FAILURE;
+    }
+  }
+
+  /* The tiles serve the whole products. Gauss-Seidel only ever updates one
+   * row at a time, and the adaptive solver some of the rows, from the plain
+   * rows */
+  if (g->tiles.hdr != NULL && strcmp(solver, "gs") != 0 &&
+      strcmp(solver, "adaptive") != 0) {
+    c->cuts = tile_cuts(&g->tiles, c->bounds, c->no_threads, c->no_threads);
+    c->acc = (double *)malloc(sizeof(double) * g->no_nodes);
+  }
+
+  /* Computing PageRank */
+  if (c->verbose)
+    printf("Computing PageRank (%s) with %d thread(s)...\n", solver,
+           c->no_threads);
+  c->iter_edges = (double)g->no_edges;
+  c->iter_bytes = spmv_bytes(g->no_nodes, g->no_edges);
+  metrics_mark(&begin);
+  if (strcmp(solver, "gs") == 0)
+    no_iter = solve_gauss_seidel(c, q);
+  else if (strcmp(solver, "extrap") == 0)
+    no_iter = solve_extrapolated(c, q);
+  else if (strcmp(solver, "bicgstab") == 0)
+    no_iter = solve_bicgstab(c, q);
+  else if (strcmp(solver, "adaptive") == 0)
+    no_iter = solve_adaptive(c, q);
+  else
+    no_iter = solve_jacobi(c, q);
+  mark_iter(c, no_iter);
+  elapsed_time = metrics_phase("solve", &begin);
+  memcpy(p, c->p, sizeof(real) * g->no_nodes);
+  if (iter != NULL) *iter = no_iter;
+
+  if (c->verbose) {
+    printf("\riter %d\n", no_iter);
+#ifdef DEBUG
+    printf("p: ");
+    print_vec_f(p, g->no_nodes);
+#endif
+    printf("Done.\n\n");
+
+    sum = 0;
+    for (i = 0; i < g->no_nodes; ++i) sum += p[i];
+    printf("Proof of correctness:\n");
+    printf("sum(p) = %f\n\n", sum);
+
+    printf("Iterations: %d\n", no_iter);
+    printf("Elapsed time: %.3fs\n", elapsed_time);
+  }
+
+  free(c->bounds);
+  free(c->cuts);
+  free(c->acc);
+#ifdef NUMA
+  if (c->no_numa > 0) {
+    place_teardown(c, q);
+    return EXIT_SUCCESS;
+  }
+#endif
+  free(c->p);
+  free(c->p_new);
+  free(q);
+  return EXIT_SUCCESS;
+}
+
+/* Power iteration out of core, for graphs that do not fit in memory: AT is
+ * streamed from its blocks (blocks.bin, written on the first call) and p,
+ * p_new and q live in files of the cache directory, of which only one
+ * interval at a time is in memory. The intervals are sized so that about
+ * mem bytes are used. The result is written to out_path as by
+ * write_scores() */
+int pr_solve_blocked(const PR_graph *g, const PR_options *opt, size_t mem,
+                     const char *out_path, int *iter) {
+  static const char *vec_names[3] = {"p.vec", "p_new.vec", "q.vec"};
+  char path[DNAME + FNAME], vec_p[3][DNAME + FNAME];
+  Block_file bf;
+  int fd[3] = {-1, -1, -1};
+  int cur = 0, next = 1;
+  int no_threads = opt->no_threads > 0 ? opt->no_threads : 1;
+  int n = g->no_nodes;
+  double teleport = (1. - DAMPING) / (double)n;
+  double dist = DBL_MAX, dang, diff, sum = 0.;
+  double *acc;
+  real *x, *y;
+  int interval, P, len;
+  int no_iter = 0;
+  int i, j, k;
+  long lo;
+  int err = 0;
+  Metrics_mark begin, it;
+  double elapsed_time;
+
+  interval = block_interval(n, mem, sizeof(double) + 2 * sizeof(real), 1);
+  if (interval == 0) {
+    fprintf(stderr, " [ERROR] A memory budget of %lu bytes is too small\n",
+            (unsigned long)mem);
+    return EXIT_FAILURE;
+  }
+  cache_path(path, g->dir, "blocks.bin");
+  if (open_blocks(&bf, path, g->row_ptr, g->col_ind, n, interval,
+                  cache_stamp(g->hdr)) == EXIT_FAILURE)
+    return EXIT_FAILURE;
+  P = bf.hdr.no_intervals;
+  acc = (double *)malloc(sizeof(double) * interval);
+  x = (real *)malloc(sizeof(real) * interval);
+  y = (real *)malloc(sizeof(real) * interval);
+
+  for (k = 0; k < 3 && !err; ++k) {
+    cache_path(vec_p[k], g->dir, vec_names[k]);
+    err = (fd[k] = create_vector(vec_p[k], &bf, 1. / (double)n, x)) == -1;
+  }
+
+  if (opt->verbose)
+    printf("Computing PageRank out of core (%d intervals of %d nodes) with "
+           "%d thread(s)...\n",
+           P, interval, no_threads);
+  metrics_mark(&begin);
+  while (!err && dist > TOL && no_iter < MAX_ITER) {
+    if (opt->verbose) printf("\riter %d", no_iter);
+    metrics_mark(&it);
+
+    /* q = p scaled by the inverse out-degrees, and the dangling mass */
+    dang = 0.;
+    for (j = 0; j < P && !err; ++j) {
+      lo = (long)j * interval;
+      len = block_len(&bf, j);
+      err = read_slice(fd[cur], x, lo, len) == EXIT_FAILURE;
+      for (k = 0; k < len; ++k) {
+        if (g->inv_out_deg[lo + k] == 0.) dang += x[k];
+        x[k] *= g->inv_out_deg[lo + k];
+      }
+      err = err || write_slice(fd[2], x, lo, len) == EXIT_FAILURE;
+    }
+    dang /= (double)n;
+
+    /* p_new = d*(AT @ q + DTp) + (1-d)/n, one row interval at a time. Only
+     * the q slices of the non-empty blocks are read */
+    dist = 0.;
+    sum = 0.;
+    for (i = 0; i < P && !err; ++i) {
+      lo = (long)i * interval;
+      len = block_len(&bf, i);
+      memset(acc, 0, sizeof(double) * len);
+      for (j = 0; j < P && !err; ++j) {
+        if (bf.count[(long)i * P + j] == 0) continue;
+        err = read_slice(fd[2], x, (long)j * interval, block_len(&bf, j)) ==
+                  EXIT_FAILURE ||
+              block_gather(&bf, i, j, x, acc, no_threads) == EXIT_FAILURE;
+      }
+      err = err || read_slice(fd[cur], x, lo, len) == EXIT_FAILURE;
+      for (k = 0; k < len; ++k) {
+        y[k] = DAMPING * (acc[k] + dang) + teleport;
+        diff = (double)x[k] - y[k];
+        dist += diff * diff;
+        sum += y[k];
+      }
+      err = err || write_slice(fd[next], y, lo, len) == EXIT_FAILURE;
+    }
+    dist = sqrt(dist);
+    cur = next;
+    next = 1 - cur;
+    metrics_iter("pagerank", no_iter, &it, (double)g->no_edges,
+                 spmv_bytes(n, g->no_edges));
+    ++no_iter;
+  }
+  elapsed_time = metrics_phase("solve", &begin);
+
+  if (err)
+    fprintf(stderr, " [ERROR] Out-of-core PageRank could not be computed\n");
+  else
+    err = save_vector(fd[cur], n, g->perm, out_path, "output") ==
+          EXIT_FAILURE;
+  if (iter != NULL) *iter = no_iter;
+
+  if (!err && opt->verbose) {
+    printf("\riter %d\n", no_iter);
+    printf("Done.\n\n");
+    printf("Proof of correctness:\n");
+    printf("sum(p) = %f\n\n", sum);
+    printf("Iterations: %d\n", no_iter);
+    printf("Elapsed time: %.3fs\n", elapsed_time);
+  }
+
+  for (k = 0; k < 3; ++k) {
+    if (fd[k] == -1) continue;
+    close(fd[k]);
+    remove(vec_p[k]);
+  }
+  close_blocks(&bf);
+  free(acc);
+  free(x);
+  free(y);
+  return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
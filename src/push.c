@@ -0,0 +1,170 @@
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "push.h"
+
+#define DAMPING 0.85
+
+#define QUEUED 1
+#define TOUCHED 2
+
+typedef struct {
+  double est;
+  int node;
+} Push_entry;
+
+static int cmp_entry(const void *x, const void *y) {
+  double a = ((const Push_entry *)x)->est, b = ((const Push_entry *)y)->est;
+  return (a < b) - (a > b);
+}
+
+/* Sorts nodes by decreasing est. The estimates are copied next to the
+ * nodes, so that concurrent pushes do not share a comparator state */
+static void sort_by_est(int *nodes, int n, const double *est) {
+  Push_entry *e = (Push_entry *)malloc(sizeof(Push_entry) * (n > 0 ? n : 1));
+  int k;
+
+  for (k = 0; k < n; ++k) {
+    e[k].est = est[nodes[k]];
+    e[k].node = nodes[k];
+  }
+  qsort(e, n, sizeof(Push_entry), cmp_entry);
+  for (k = 0; k < n; ++k) nodes[k] = e[k].node;
+  free(e);
+}
+
+static void append(int **v, int *n, int *cap, int x) {
+  if (*n == *cap) {
+    *cap *= 2;
+    *v = (int *)realloc(*v, sizeof(int) * *cap);
+  }
+  (*v)[(*n)++] = x;
+}
+
+/* Approximate personalized PageRank of a single source by forward push
+ * (Andersen, Chung and Lang). A node is pushed while its residual is at
+ * least eps times its out-degree, so the work only depends on eps and on
+ * the neighbourhood of the source. The dense arrays come from calloc, whose
+ * zero pages are only materialized where the push touches them. On return
+ * *est holds the estimates and *touched the *no_touched nodes reached, by
+ * decreasing estimate; both are to be freed by the caller. The number of
+ * pushes and of edges scanned go to stats[0] and stats[1] */
+void push_ppr(const eidx *out_ptr, const int *out_ind, int no_nodes,
+              int source, double eps, double **est_out, int **touched_out,
+              int *no_touched_out, long stats[2]) {
+  double *est = (double *)calloc(no_nodes, sizeof(double));
+  double *res = (double *)calloc(no_nodes, sizeof(double));
+  char *flag = (char *)calloc(no_nodes, sizeof(char));
+  int cap_cur = 64, cap_next = 64, cap_touched = 64;
+  int *cur = (int *)malloc(sizeof(int) * cap_cur);
+  int *next = (int *)malloc(sizeof(int) * cap_next);
+  int *touched = (int *)malloc(sizeof(int) * cap_touched);
+  int no_cur = 0, no_next, no_touched = 0;
+  int *tmp;
+  long pushes = 0, edges = 0;
+  double r, share;
+  eidx deg, ci;
+  int u, v, k;
+
+  res[source] = 1.;
+  flag[source] = QUEUED | TOUCHED;
+  append(&touched, &no_touched, &cap_touched, source);
+  append(&cur, &no_cur, &cap_cur, source);
+
+  while (no_cur > 0) {
+    no_next = 0;
+    for (k = 0; k < no_cur; ++k) {
+      u = cur[k];
+      flag[u] &= ~QUEUED;
+      deg = out_ptr[u + 1] - out_ptr[u];
+      r = res[u];
+      res[u] = 0.;
+      est[u] += (1. - DAMPING) * r;
+      ++pushes;
+
+      /* A dangling node sends its mass back to the source */
+      if (deg == 0) {
+        res[source] += DAMPING * r;
+        if (!(flag[source] & QUEUED) && res[source] >= eps) {
+          flag[source] |= QUEUED;
+          append(&next, &no_next, &cap_next, source);
+        }
+        continue;
+      }
+
+      share = DAMPING * r / (double)deg;
+      edges += deg;
+      for (ci = out_ptr[u]; ci < out_ptr[u + 1]; ++ci) {
+        v = out_ind[ci];
+        res[v] += share;
+        if (!(flag[v] & TOUCHED)) {
+          flag[v] |= TOUCHED;
+          append(&touched, &no_touched, &cap_touched, v);
+        }
+        deg = out_ptr[v + 1] - out_ptr[v];
+        if (!(flag[v] & QUEUED) && res[v] >= eps * (deg > 0 ? deg : 1)) {
+          flag[v] |= QUEUED;
+          append(&next, &no_next, &cap_next, v);
+        }
+      }
+    }
+    tmp = cur;
+    cur = next;
+    next = tmp;
+    k = cap_cur;
+    cap_cur = cap_next;
+    cap_next = k;
+    no_cur = no_next;
+  }
+
+  sort_by_est(touched, no_touched, est);
+
+  free(res);
+  free(flag);
+  free(cur);
+  free(next);
+  *est_out = est;
+  *touched_out = touched;
+  *no_touched_out = no_touched;
+  stats[0] = pushes;
+  stats[1] = edges;
+}
+
+int compute_push(const eidx *out_ptr, const int *out_ind, int no_nodes,
+                 const int *ids, int source, double eps, const char *out_path) {
+  FILE *pf;
+  double *est;
+  int *touched;
+  int no_touched;
+  long stats[2];
+  double begin, elapsed_time;
+  int k;
+
+  begin = omp_get_wtime();
+  push_ppr(out_ptr, out_ind, no_nodes, source, eps, &est, &touched,
+           &no_touched, stats);
+  elapsed_time = omp_get_wtime() - begin;
+
+  printf("Pushes: %ld, edges scanned: %ld, nodes touched: %d\n", stats[0],
+         stats[1], no_touched);
+  printf("Elapsed time: %.6fs\n\n", elapsed_time);
+  printf("Top nodes:\n");
+  for (k = 0; k < no_touched && k < PUSH_SHOW && est[touched[k]] > 0.; ++k)
+    printf("%d %.6e\n", ids != NULL ? ids[touched[k]] : touched[k],
+           est[touched[k]]);
+
+  if ((pf = fopen(out_path, "w")) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot create file \"%s\"\n", out_path);
+  } else {
+    fprintf(pf, "node,ppr\n");
+    for (k = 0; k < no_touched && est[touched[k]] > 0.; ++k)
+      fprintf(pf, "%d,%.6e\n", ids != NULL ? ids[touched[k]] : touched[k],
+              est[touched[k]]);
+    fclose(pf);
+  }
+
+  free(est);
+  free(touched);
+  return pf == NULL ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,15 @@
+#ifndef PUSH_H
+#define PUSH_H
+
+#include "utils.h"
+
+#define PUSH_EPS 1.e-7
+#define PUSH_SHOW 10
+
+void push_ppr(const eidx *out_ptr, const int *out_ind, int no_nodes,
+              int source, double eps, double **est_out, int **touched_out,
+              int *no_touched_out, long stats[2]);
+int compute_push(const eidx *out_ptr, const int *out_ind, int no_nodes,
+                 const int *ids, int source, double eps, const char *out_path);
+
+#endif
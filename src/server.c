@@ -0,0 +1,512 @@
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "irws.h"
+#include "jaccard.h"
+#include "push.h"
+
+#define SERVER_WORKERS 4
+#define SERVER_QUEUE 64
+#define SERVER_MAX_GRAPHS 16
+#define SERVER_TOP_K 10
+/* Smallest eps of a ppr request: the work of a push grows as 1/eps */
+#define SERVER_MIN_EPS 1.e-9
+
+/* Score vectors served for every graph: PageRank, authorities, hubs */
+#define NO_SCORES 3
+const char *score_names[NO_SCORES] = {"pr", "a", "h"};
+
+/* A graph loaded by the server. Score vectors are indexed by the node ids
+ * of the input file, the caches by their own (possibly reordered) ids */
+typedef struct {
+  char name[FNAME];
+  /* PageRank cache: out-links for the push queries */
+  PR_graph pr;
+  int pr_nodes;
+  eidx *out_ptr;
+  int *out_ind;
+  int *pr_perm, *pr_ids;
+  /* HITS cache: sorted in-links for Jaccard */
+  HITS_graph hits;
+  int hits_nodes;
+  eidx hits_edges;
+  eidx *row_ptr_t;
+  int *col_ind_t;
+  int *hits_perm;
+  /* Scores, and the nodes sorted by decreasing score */
+  int score_nodes[NO_SCORES];
+  double *score[NO_SCORES];
+  int *rank[NO_SCORES];
+} Graph_data;
+
+Graph_data graphs[SERVER_MAX_GRAPHS];
+int no_graphs = 0;
+int no_workers = SERVER_WORKERS;
+char socket_p[PATH] = {0};
+
+/* Connections accepted and waiting for a worker */
+int queue[SERVER_QUEUE];
+int queue_head = 0, queue_len = 0;
+pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t queue_not_empty = PTHREAD_COND_INITIALIZER;
+pthread_cond_t queue_not_full = PTHREAD_COND_INITIALIZER;
+
+volatile sig_atomic_t stop = 0;
+
+void on_signal(int sig);
+int load_graph(const char *dataset, Graph_data *g);
+void serve_stream(FILE *in, FILE *out);
+void *worker(void *arg);
+
+int main(int argc, char *argv[]) {
+  struct sockaddr_un addr;
+  struct sigaction sa;
+  sigset_t mask;
+  pthread_t tid;
+  int sock, fd, err;
+  int opt;
+  int i;
+
+  while ((opt = getopt(argc, argv, "t:s:")) != -1) {
+    switch (opt) {
+      case 't':
+        if (sscanf(optarg, "%d", &no_workers) != 1 || no_workers < 1) {
+          fprintf(stderr, " [ERROR] Invalid number of workers \"%s\"\n",
+                  optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      case 's':
+        strncpy(socket_p, optarg, PATH - 1);
+        break;
+      default:
+        fprintf(stderr,
+                " [ERROR] Usage: ./irwsd [-t <workers>] [-s <socket_path>] "
+                "<arg_name> [<arg_name> ...]\n");
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  if (argc - optind < 1 || argc - optind > SERVER_MAX_GRAPHS) {
+    fprintf(stderr, " [ERROR] 1 to %d graphs required: ./irwsd <arg_name>\n",
+            SERVER_MAX_GRAPHS);
+    exit(EXIT_FAILURE);
+  }
+  for (i = optind; i < argc; ++i)
+    if (load_graph(argv[i], &graphs[no_graphs++]) == EXIT_FAILURE)
+      exit(EXIT_FAILURE);
+
+  /* Without a socket the requests come from stdin */
+  if (socket_p[0] == '\0') {
+    serve_stream(stdin, stdout);
+    return EXIT_SUCCESS;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(socket_p) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, " [ERROR] Socket path \"%s\" is too long\n", socket_p);
+    exit(EXIT_FAILURE);
+  }
+  strcpy(addr.sun_path, socket_p);
+  unlink(socket_p);
+  if ((sock = socket(AF_UNIX, SOCK_STREAM, 0)) == -1 ||
+      bind(sock, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+      listen(sock, SOMAXCONN) == -1) {
+    fprintf(stderr, " [ERROR] Cannot listen on \"%s\": %s\n", socket_p,
+            strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  /* accept() must return on SIGINT/SIGTERM, and a client that goes away
+   * must not kill the server */
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = SIG_IGN;
+  sigaction(SIGPIPE, &sa, NULL);
+  sa.sa_handler = on_signal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  /* The workers inherit a mask blocking both signals, so that they are
+   * always delivered to the main thread, the one blocked in accept() */
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &mask, NULL);
+  for (i = 0; i < no_workers; ++i) {
+    if ((err = pthread_create(&tid, NULL, worker, NULL)) != 0) {
+      fprintf(stderr, " [ERROR] Cannot start a worker: %s\n",
+              strerror(err));
+      exit(EXIT_FAILURE);
+    }
+    pthread_detach(tid);
+  }
+  pthread_sigmask(SIG_UNBLOCK, &mask, NULL);
+  printf("Listening on \"%s\" with %d worker(s)\n", socket_p, no_workers);
+  fflush(stdout);
+
+  while (!stop) {
+    if ((fd = accept(sock, NULL, NULL)) == -1) continue;
+    pthread_mutex_lock(&queue_lock);
+    while (queue_len == SERVER_QUEUE)
+      pthread_cond_wait(&queue_not_full, &queue_lock);
+    queue[(queue_head + queue_len++) % SERVER_QUEUE] = fd;
+    pthread_cond_signal(&queue_not_empty);
+    pthread_mutex_unlock(&queue_lock);
+  }
+
+  close(sock);
+  unlink(socket_p);
+  printf("Stopped.\n");
+  return EXIT_SUCCESS;
+}
+
+void on_signal(int sig) {
+  (void)sig;
+  stop = 1;
+}
+
+/* Scores used to sort the nodes of a graph at load time */
+static const double *rank_score = NULL;
+
+static int cmp_rank(const void *x, const void *y) {
+  double a = rank_score[*(const int *)x], b = rank_score[*(const int *)y];
+  return (a < b) - (a > b);
+}
+
+/* Opens the PageRank cache in dir and maps its out-links, building them
+ * from AT if no query stored them yet, or if they were stored for an older
+ * cache */
+static int load_pr_cache(const char *dir, Graph_data *g) {
+  char path[DNAME + FNAME], out_ptr_p[DNAME + FNAME], out_ind_p[DNAME + FNAME];
+  PR_graph *pr = &g->pr;
+  int i, err;
+
+  sprintf(path, "%s%s", dir, CACHE_FILE);
+  if (access(path, F_OK) == -1) return EXIT_SUCCESS;
+  if (pr_open(pr, dir, IRWS_VERIFY, no_workers) == EXIT_FAILURE)
+    return EXIT_FAILURE;
+  g->pr_nodes = pr->no_nodes;
+  g->pr_perm = pr->perm;
+
+  sprintf(out_ptr_p, "%sout_ptr.bin", dir);
+  sprintf(out_ind_p, "%sout_ind.bin", dir);
+  err = load_transpose(out_ptr_p, out_ind_p, pr->row_ptr, pr->col_ind,
+                       pr->no_nodes, cache_stamp(pr->hdr), 1, &g->out_ptr,
+                       &g->out_ind);
+  if (err == EXIT_FAILURE) return EXIT_FAILURE;
+  munmap(g->out_ptr, (pr->no_nodes + 1) * sizeof(eidx));
+  munmap(g->out_ind, pr->no_edges * sizeof(int));
+  g->out_ind = NULL;
+
+  if ((g->out_ptr = (eidx *)mmap_populated(out_ptr_p, sizeof(eidx),
+                                           pr->no_nodes + 1)) == NULL ||
+      (pr->no_edges > 0 &&
+       (g->out_ind = (int *)mmap_populated(out_ind_p, sizeof(int),
+                                           pr->no_edges)) == NULL))
+    return EXIT_FAILURE;
+
+  if (g->pr_perm != NULL) {
+    g->pr_ids = (int *)malloc(sizeof(int) * g->pr_nodes);
+    for (i = 0; i < g->pr_nodes; ++i) g->pr_ids[g->pr_perm[i]] = i;
+  }
+  printf("  %s: %d nodes, %ld edges\n", dir, pr->no_nodes,
+         (long)pr->no_edges);
+  return EXIT_SUCCESS;
+}
+
+/* Opens the HITS cache in dir, for its sorted in-links */
+static int load_hits_cache(const char *dir, Graph_data *g) {
+  char path[DNAME + FNAME];
+  HITS_graph *hits = &g->hits;
+
+  sprintf(path, "%s%s", dir, CACHE_FILE);
+  if (access(path, F_OK) == -1) return EXIT_SUCCESS;
+  if (hits_open(hits, dir, IRWS_POPULATE | IRWS_VERIFY, no_workers) ==
+      EXIT_FAILURE)
+    return EXIT_FAILURE;
+  g->hits_nodes = hits->no_nodes;
+  g->hits_edges = hits->no_edges;
+  g->row_ptr_t = hits->row_ptr_t;
+  g->col_ind_t = hits->col_ind_t;
+  g->hits_perm = hits->perm;
+  printf("  %s: %d nodes, %ld edges\n", dir, g->hits_nodes,
+         (long)g->hits_edges);
+  return EXIT_SUCCESS;
+}
+
+/* Maps a score vector written by write_scores() and ranks its nodes */
+static int load_scores(const char *path, Graph_data *g, int s) {
+  struct stat st;
+  int i, n;
+
+  if (stat(path, &st) == -1 || st.st_size < (off_t)sizeof(double))
+    return EXIT_SUCCESS;
+  n = (int)(st.st_size / sizeof(double));
+  if ((g->score[s] = (double *)mmap_populated(path, sizeof(double), n)) ==
+      NULL)
+    return EXIT_FAILURE;
+  g->score_nodes[s] = n;
+  g->rank[s] = (int *)malloc(sizeof(int) * n);
+  for (i = 0; i < n; ++i) g->rank[s][i] = i;
+  rank_score = g->score[s];
+  qsort(g->rank[s], n, sizeof(int), cmp_rank);
+  rank_score = NULL;
+  printf("  %s: %d scores\n", path, n);
+  return EXIT_SUCCESS;
+}
+
+/* Loads whatever was computed for data/<name>.txt: the PR_<name>/ and
+ * HITS_<name>/ caches and the <name>.pr, <name>_a.hits, <name>_h.hits
+ * results. Every mapping is populated up front */
+int load_graph(const char *dataset, Graph_data *g) {
+  char dir[FNAME + 8], path[FNAME + 16];
+  int s;
+
+  memset(g, 0, sizeof(Graph_data));
+  if (strlen(dataset) < 10 || strlen(dataset) - 9 >= FNAME) {
+    fprintf(stderr, " [ERROR] Expected data/<name>.txt, got \"%s\"\n",
+            dataset);
+    return EXIT_FAILURE;
+  }
+  strncpy(g->name, dataset + 5, strlen(dataset) - 9);
+  g->name[strlen(dataset) - 9] = '\0';
+  printf("Loading %s...\n", g->name);
+
+  sprintf(dir, "PR_%s/", g->name);
+  if (load_pr_cache(dir, g) == EXIT_FAILURE) {
+    fprintf(stderr, " [ERROR] Cannot load \"%s\"\n", dir);
+    return EXIT_FAILURE;
+  }
+  sprintf(dir, "HITS_%s/", g->name);
+  if (load_hits_cache(dir, g) == EXIT_FAILURE) {
+    fprintf(stderr, " [ERROR] Cannot load \"%s\"\n", dir);
+    return EXIT_FAILURE;
+  }
+  for (s = 0; s < NO_SCORES; ++s) {
+    if (s == 0)
+      sprintf(path, "%s.pr", g->name);
+    else
+      sprintf(path, "%s_%s.hits", g->name, score_names[s]);
+    if (load_scores(path, g, s) == EXIT_FAILURE) {
+      fprintf(stderr, " [ERROR] Cannot load \"%s\"\n", path);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (g->out_ptr == NULL && g->row_ptr_t == NULL && g->score[0] == NULL &&
+      g->score[1] == NULL && g->score[2] == NULL) {
+    fprintf(stderr,
+            " [ERROR] Nothing computed for \"%s\", run ./pagerank or ./hits "
+            "first\n",
+            dataset);
+    return EXIT_FAILURE;
+  }
+  printf("Done.\n\n");
+  return EXIT_SUCCESS;
+}
+
+static Graph_data *find_graph(const char *name) {
+  int i;
+
+  for (i = 0; name != NULL && i < no_graphs; ++i)
+    if (strcmp(graphs[i].name, name) == 0) return &graphs[i];
+  return NULL;
+}
+
+static int find_score(const char *name) {
+  int s;
+
+  for (s = 0; name != NULL && s < NO_SCORES; ++s)
+    if (strcmp(score_names[s], name) == 0) return s;
+  return -1;
+}
+
+/* Parses a non-negative int, returns -1 if tok is not one */
+static int parse_id(const char *tok) {
+  char *end;
+  long x;
+
+  if (tok == NULL) return -1;
+  x = strtol(tok, &end, 10);
+  return end == tok || *end != '\0' || x < 0 || x > 0x7fffffff ? -1 : (int)x;
+}
+
+/* eps of a ppr request, PUSH_EPS if tok is NULL, -1 if tok is not a
+ * positive number. It is raised to SERVER_MIN_EPS, so that one request
+ * cannot hold a worker for ever */
+static double parse_eps(const char *tok) {
+  char *end;
+  double x;
+
+  if (tok == NULL) return PUSH_EPS;
+  x = strtod(tok, &end);
+  if (end == tok || *end != '\0' || !(x > 0.)) return -1.;
+  return x < SERVER_MIN_EPS ? SERVER_MIN_EPS : x;
+}
+
+/* Answers one request on out, see the README for the protocol. Returns 0
+ * when the client asked to close the connection */
+static int serve_request(char *line, FILE *out) {
+  const char *sep = " \t\r\n";
+  char *save = NULL;
+  char *cmd = strtok_r(line, sep, &save);
+  char *arg[4];
+  Graph_data *g;
+  double *est;
+  int *touched;
+  int no_touched;
+  long stats[2];
+  double eps;
+  int s, u, v, k, K;
+
+  if (cmd == NULL) return 1;
+  for (k = 0; k < 4; ++k) arg[k] = strtok_r(NULL, sep, &save);
+
+  if (strcmp(cmd, "quit") == 0) return 0;
+
+  if (strcmp(cmd, "graphs") == 0) {
+    fprintf(out, "OK %d\n", no_graphs);
+    for (k = 0; k < no_graphs; ++k)
+      fprintf(out, "%s %d %d\n", graphs[k].name, graphs[k].pr_nodes,
+              graphs[k].hits_nodes);
+    return 1;
+  }
+
+  if ((g = find_graph(arg[0])) == NULL) {
+    fprintf(out, "ERR unknown command or graph\n");
+    return 1;
+  }
+
+  /* score <graph> pr|a|h <node> */
+  if (strcmp(cmd, "score") == 0) {
+    s = find_score(arg[1]);
+    u = parse_id(arg[2]);
+    if (s < 0 || g->score[s] == NULL)
+      fprintf(out, "ERR no such score\n");
+    else if (u < 0 || u >= g->score_nodes[s])
+      fprintf(out, "ERR invalid node\n");
+    else
+      fprintf(out, "OK 1\n%.10e\n", g->score[s][u]);
+
+    /* top <graph> pr|a|h [<K>] */
+  } else if (strcmp(cmd, "top") == 0) {
+    s = find_score(arg[1]);
+    K = arg[2] != NULL ? parse_id(arg[2]) : SERVER_TOP_K;
+    if (s < 0 || g->score[s] == NULL) {
+      fprintf(out, "ERR no such score\n");
+    } else if (K < 0) {
+      fprintf(out, "ERR invalid K\n");
+    } else {
+      if (K > g->score_nodes[s]) K = g->score_nodes[s];
+      fprintf(out, "OK %d\n", K);
+      for (k = 0; k < K; ++k)
+        fprintf(out, "%d %.10e\n", g->rank[s][k],
+                g->score[s][g->rank[s][k]]);
+    }
+
+    /* ppr <graph> <node> [<K> [<eps>]] */
+  } else if (strcmp(cmd, "ppr") == 0) {
+    u = parse_id(arg[1]);
+    K = arg[2] != NULL ? parse_id(arg[2]) : SERVER_TOP_K;
+    eps = parse_eps(arg[3]);
+    if (g->out_ptr == NULL) {
+      fprintf(out, "ERR no PageRank cache\n");
+    } else if (u < 0 || u >= g->pr_nodes) {
+      fprintf(out, "ERR invalid node\n");
+    } else if (K < 0 || !(eps > 0.)) {
+      fprintf(out, "ERR invalid K or eps\n");
+    } else {
+      push_ppr(g->out_ptr, g->out_ind, g->pr_nodes,
+               g->pr_perm != NULL ? g->pr_perm[u] : u, eps, &est, &touched,
+               &no_touched, stats);
+      while (no_touched > 0 && est[touched[no_touched - 1]] <= 0.)
+        --no_touched;
+      if (K > no_touched) K = no_touched;
+      fprintf(out, "OK %d\n", K);
+      for (k = 0; k < K; ++k)
+        fprintf(out, "%d %.6e\n",
+                g->pr_ids != NULL ? g->pr_ids[touched[k]] : touched[k],
+                est[touched[k]]);
+      free(est);
+      free(touched);
+    }
+
+    /* jaccard <graph> <node> <node> */
+  } else if (strcmp(cmd, "jaccard") == 0) {
+    u = parse_id(arg[1]);
+    v = parse_id(arg[2]);
+    if (g->row_ptr_t == NULL) {
+      fprintf(out, "ERR no HITS cache\n");
+    } else if (u < 0 || u >= g->hits_nodes || v < 0 || v >= g->hits_nodes) {
+      fprintf(out, "ERR invalid node\n");
+    } else {
+      if (g->hits_perm != NULL) {
+        u = g->hits_perm[u];
+        v = g->hits_perm[v];
+      }
+      fprintf(out, "OK 1\n%.6f\n",
+              jaccard_pair(g->row_ptr_t, g->col_ind_t, u, v));
+    }
+  } else {
+    fprintf(out, "ERR unknown command or graph\n");
+  }
+  return 1;
+}
+
+/* Answers the requests of one client, one per line, until it quits or
+ * closes the stream */
+void serve_stream(FILE *in, FILE *out) {
+  char *line = NULL;
+  size_t len = 0;
+
+  while (getline(&line, &len, in) != -1) {
+    if (!serve_request(line, out)) break;
+    if (fflush(out) == EOF) break;
+  }
+  fflush(out);
+  free(line);
+}
+
+/* Serves the connections of the queue, one at a time */
+void *worker(void *arg) {
+  FILE *in, *out;
+  int fd, fd_out;
+
+  (void)arg;
+  for (;;) {
+    pthread_mutex_lock(&queue_lock);
+    while (queue_len == 0) pthread_cond_wait(&queue_not_empty, &queue_lock);
+    fd = queue[queue_head];
+    queue_head = (queue_head + 1) % SERVER_QUEUE;
+    --queue_len;
+    pthread_cond_signal(&queue_not_full);
+    pthread_mutex_unlock(&queue_lock);
+
+    /* Reading and writing go through separate streams */
+    if ((fd_out = dup(fd)) == -1 || (in = fdopen(fd, "r")) == NULL) {
+      close(fd);
+      if (fd_out != -1) close(fd_out);
+      continue;
+    }
+    if ((out = fdopen(fd_out, "w")) == NULL) {
+      fclose(in);
+      close(fd_out);
+      continue;
+    }
+    serve_stream(in, out);
+    fclose(in);
+    fclose(out);
+  }
+  return NULL;
+}
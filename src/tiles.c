@@ -0,0 +1,240 @@
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "tiles.h"
+
+/* Sections of the tile file */
+#define SEC_INFO 0
+#define SEC_TILE_START 1
+#define SEC_ROWS 2
+#define SEC_PTR 3
+#define SEC_COLS 4
+#define NO_SECTIONS 5
+
+/* Tile width for this machine: half of the L2 cache holds the tile of the
+ * gathered vector, the other half is left to the streamed matrix and to
+ * the result */
+static int tile_width(void) {
+  long l2 = 0, width;
+
+#ifdef _SC_LEVEL2_CACHE_SIZE
+  l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+  if (l2 <= 0) l2 = 512 * 1024;
+  width = l2 / 2 / (long)sizeof(real);
+  if (width > TILE_MAX_WIDTH) width = TILE_MAX_WIDTH;
+  if (width < TILE_MIN_WIDTH) width = TILE_MIN_WIDTH;
+  return (int)width;
+}
+
+/* Writes the tiles of the CSR matrix (row_ptr, col_ind) of the graph
+ * cache graph. A first pass counts the tile rows and the entries of every
+ * tile, a second one fills them, both reading the matrix in order */
+static int write_tiles(const char path[], const Cache_header *graph,
+                       const eidx *row_ptr, const int *col_ind,
+                       int no_threads) {
+  Cache_header hdr;
+  const void *data[NO_SECTIONS];
+  int no_nodes = graph->no_nodes;
+  int width = tile_width();
+  int S = (no_nodes + width - 1) / width;
+  int info[2];
+  eidx *tile_start = (eidx *)calloc(S + 1, sizeof(eidx));
+  eidx *ent_start = (eidx *)calloc(S + 1, sizeof(eidx));
+  eidx *rcur = (eidx *)malloc(sizeof(eidx) * (S + 1));
+  eidx *ecur = (eidx *)malloc(sizeof(eidx) * (S + 1));
+  int *last = (int *)malloc(sizeof(int) * (S + 1));
+  int *rows;
+  eidx *ptr;
+  unsigned short *cols;
+  eidx ci, k, no_rows;
+  int ri, s;
+  int err;
+
+  printf("Tiling adjacency lists in %d tile(s) of %d nodes...\n", S, width);
+  for (s = 0; s < S; ++s) last[s] = -1;
+  for (ri = 0; ri < no_nodes; ++ri) {
+    for (ci = row_ptr[ri]; ci < row_ptr[ri + 1]; ++ci) {
+      s = col_ind[ci] / width;
+      ++ent_start[s + 1];
+      if (last[s] != ri) {
+        last[s] = ri;
+        ++tile_start[s + 1];
+      }
+    }
+  }
+  for (s = 0; s < S; ++s) {
+    tile_start[s + 1] += tile_start[s];
+    ent_start[s + 1] += ent_start[s];
+    rcur[s] = tile_start[s];
+    ecur[s] = ent_start[s];
+    last[s] = -1;
+  }
+  no_rows = tile_start[S];
+
+  rows = (int *)malloc(sizeof(int) * ((size_t)no_rows + 1));
+  ptr = (eidx *)malloc(sizeof(eidx) * ((size_t)no_rows + 1));
+  cols = (unsigned short *)malloc(sizeof(unsigned short) *
+                                  ((size_t)ent_start[S] + 1));
+  for (ri = 0; ri < no_nodes; ++ri) {
+    for (ci = row_ptr[ri]; ci < row_ptr[ri + 1]; ++ci) {
+      s = col_ind[ci] / width;
+      if (last[s] != ri) {
+        last[s] = ri;
+        k = rcur[s]++;
+        rows[k] = ri;
+        ptr[k] = ecur[s];
+      }
+      cols[ecur[s]++] = (unsigned short)(col_ind[ci] - s * width);
+    }
+  }
+  ptr[no_rows] = ent_start[S];
+
+  /* The tiles are stamped with the graph cache they come from */
+  init_cache_header(&hdr, NULL);
+  hdr.src_size = graph->src_size;
+  hdr.src_mtime = graph->src_mtime;
+  hdr.no_nodes = no_nodes;
+  hdr.no_edges = ent_start[S];
+  hdr.no_sections = NO_SECTIONS;
+  hdr.stamp = cache_stamp(graph);
+  info[0] = width;
+  info[1] = S;
+  data[SEC_INFO] = info;
+  hdr.section[SEC_INFO].size = sizeof(info);
+  data[SEC_TILE_START] = tile_start;
+  hdr.section[SEC_TILE_START].size = sizeof(eidx) * (S + 1L);
+  data[SEC_ROWS] = rows;
+  hdr.section[SEC_ROWS].size = sizeof(int) * (long)no_rows;
+  data[SEC_PTR] = ptr;
+  hdr.section[SEC_PTR].size = sizeof(eidx) * (no_rows + 1L);
+  data[SEC_COLS] = cols;
+  hdr.section[SEC_COLS].size = sizeof(unsigned short) * (long)ent_start[S];
+  err = write_cache(path, &hdr, data, no_threads) == EXIT_FAILURE;
+  if (!err)
+    printf("%ld tile rows for %d rows\n", (long)no_rows, no_nodes);
+
+  free(tile_start);
+  free(ent_start);
+  free(rcur);
+  free(ecur);
+  free(last);
+  free(rows);
+  free(ptr);
+  free(cols);
+  return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* Whether the tile file hdr was built from the graph cache graph, with
+ * sections of the sizes its counts give them */
+static int same_graph(const Cache_header *hdr, const Cache_header *graph) {
+  const Cache_section *s = hdr->section;
+  const int *info;
+  long no_rows;
+
+  if (hdr->no_sections != NO_SECTIONS || hdr->no_nodes != graph->no_nodes ||
+      hdr->no_edges != graph->no_edges || hdr->stamp != cache_stamp(graph) ||
+      s[SEC_INFO].size != 2 * (long)sizeof(int))
+    return 0;
+  info = (const int *)((const char *)hdr + s[SEC_INFO].offset);
+  no_rows = s[SEC_ROWS].size / (long)sizeof(int);
+  return info[1] >= 0 &&
+         s[SEC_TILE_START].size == (long)sizeof(eidx) * (info[1] + 1L) &&
+         s[SEC_ROWS].size == (long)sizeof(int) * no_rows &&
+         s[SEC_PTR].size == (long)sizeof(eidx) * (no_rows + 1) &&
+         s[SEC_COLS].size == (long)sizeof(unsigned short) * hdr->no_edges;
+}
+
+/* Maps the tiles of the CSR matrix (row_ptr, col_ind) of the graph cache
+ * graph from path, with the map_cache() flags, building them first if path
+ * does not hold them yet */
+int load_tiles(const char path[], const Cache_header *graph,
+               const eidx *row_ptr, const int *col_ind, int flags,
+               int no_threads, Tile_csr *tc) {
+  const char *base;
+  const int *info;
+
+  memset(tc, 0, sizeof(Tile_csr));
+  if (cache_check(path, NULL) == CACHE_OK &&
+      (tc->hdr = map_cache(path, flags, no_threads, &tc->map_len)) != NULL &&
+      !same_graph(tc->hdr, graph)) {
+    munmap((void *)tc->hdr, tc->map_len);
+    tc->hdr = NULL;
+  }
+  if (tc->hdr == NULL &&
+      (write_tiles(path, graph, row_ptr, col_ind, no_threads) ==
+           EXIT_FAILURE ||
+       (tc->hdr = map_cache(path, flags, no_threads, &tc->map_len)) == NULL))
+    return EXIT_FAILURE;
+
+  base = (const char *)tc->hdr;
+  info = (const int *)(base + tc->hdr->section[SEC_INFO].offset);
+  tc->width = info[0];
+  tc->no_tiles = info[1];
+  tc->tile_start =
+      (const eidx *)(base + tc->hdr->section[SEC_TILE_START].offset);
+  tc->rows = (const int *)(base + tc->hdr->section[SEC_ROWS].offset);
+  tc->ptr = (const eidx *)(base + tc->hdr->section[SEC_PTR].offset);
+  tc->cols =
+      (const unsigned short *)(base + tc->hdr->section[SEC_COLS].offset);
+  return EXIT_SUCCESS;
+}
+
+void close_tiles(Tile_csr *tc) {
+  if (tc->hdr != NULL) munmap((void *)tc->hdr, tc->map_len);
+  memset(tc, 0, sizeof(Tile_csr));
+}
+
+/* Splits every tile along the row bounds of the no_parts parts: the tile
+ * rows of tile s in part t are [cuts[s*(no_parts+1)+t],
+ * cuts[s*(no_parts+1)+t+1]) */
+eidx *tile_cuts(const Tile_csr *tc, const int *bounds, int no_parts,
+                int no_threads) {
+  eidx *cuts = (eidx *)malloc(sizeof(eidx) *
+                              ((size_t)tc->no_tiles * (no_parts + 1) + 1));
+  int s;
+
+#pragma omp parallel for num_threads(no_threads)
+  for (s = 0; s < tc->no_tiles; ++s) {
+    eidx lo = tc->tile_start[s], hi = tc->tile_start[s + 1], mid;
+    int t;
+
+    for (t = 0; t <= no_parts; ++t) {
+      /* First tile row from bounds[t] on, the earlier ones being done */
+      while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (tc->rows[mid] < bounds[t])
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+      cuts[(size_t)s * (no_parts + 1) + t] = lo;
+      hi = tc->tile_start[s + 1];
+    }
+  }
+  return cuts;
+}
+
+/* acc[ri] += (M @ x)[ri] for the rows of part t, tile after tile */
+void tile_product(const Tile_csr *tc, const eidx *cuts, int no_parts, int t,
+                  const real *x, double *acc) {
+  const eidx *cut = cuts + t;
+  const real *xs = x;
+  double sum;
+  eidx k, e;
+  int s;
+
+  for (s = 0; s < tc->no_tiles; ++s) {
+    for (k = cut[0]; k < cut[1]; ++k) {
+      sum = 0.;
+      for (e = tc->ptr[k]; e < tc->ptr[k + 1]; ++e) sum += xs[tc->cols[e]];
+      acc[tc->rows[k]] += sum;
+    }
+    cut += no_parts + 1;
+    xs += tc->width;
+  }
+}
@@ -0,0 +1,39 @@
+#ifndef TILES_H
+#define TILES_H
+
+#include "utils.h"
+
+/* Cache-blocked form of a CSR matrix (CSR segmenting). The columns are
+ * split into tiles of `width` nodes, sized after the L2 cache, and every
+ * tile holds the rows that have entries in its columns, with the columns
+ * stored as 16 bit offsets into the tile. A product walks the tiles one
+ * after the other, so the gathered vector is only read within one
+ * cache-sized segment at a time, and adds every tile row into the rows of
+ * the result in increasing order. The tiles are a cache container of their
+ * own, stamped with the graph cache they were built from */
+#define TILE_MAX_WIDTH 65536
+#define TILE_MIN_WIDTH 1024
+
+typedef struct {
+  const Cache_header *hdr;
+  size_t map_len;
+  int width;
+  int no_tiles;
+  /* Tile rows of tile s: [tile_start[s], tile_start[s + 1]) */
+  const eidx *tile_start;
+  /* Row of every tile row, and its entries [ptr[k], ptr[k + 1]) */
+  const int *rows;
+  const eidx *ptr;
+  const unsigned short *cols;
+} Tile_csr;
+
+int load_tiles(const char path[], const Cache_header *graph,
+               const eidx *row_ptr, const int *col_ind, int flags,
+               int no_threads, Tile_csr *tc);
+void close_tiles(Tile_csr *tc);
+eidx *tile_cuts(const Tile_csr *tc, const int *bounds, int no_parts,
+                int no_threads);
+void tile_product(const Tile_csr *tc, const eidx *cuts, int no_parts, int t,
+                  const real *x, double *acc);
+
+#endif
@@ -2,11 +2,17 @@
 
 #include <dirent.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include "metrics.h"
+
 /* Helper functions */
 
 int write_data(const char path[], const void *data, size_t nmemb, size_t size) {
@@ -21,6 +27,45 @@ int write_data(const char path[], const void *data, size_t nmemb, size_t size) {
   return EXIT_SUCCESS;
 }
 
+/* Same as write_data(), the data being followed by stamp. A file written
+ * last of a set, stamped, vouches for the whole set */
+int write_stamped(const char path[], const void *data, size_t nmemb,
+                  size_t size, unsigned long stamp) {
+  FILE *pdata;
+  int err;
+
+  if ((pdata = fopen(path, "wb")) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot create file \"%s\"\n", path);
+    return EXIT_FAILURE;
+  }
+  err = fwrite(data, size, nmemb, pdata) != nmemb ||
+        fwrite(&stamp, sizeof(stamp), 1, pdata) != 1;
+  err = fclose(pdata) != 0 || err;
+  if (err) {
+    fprintf(stderr, " [ERROR] Cannot write file \"%s\"\n", path);
+    remove(path);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/* Whether path holds len bytes of data followed by stamp */
+int check_stamp(const char path[], long len, unsigned long stamp) {
+  struct stat st;
+  unsigned long s = 0;
+  FILE *pf;
+  int ok;
+
+  if (stat(path, &st) == -1 ||
+      (long)st.st_size != len + (long)sizeof(stamp) ||
+      (pf = fopen(path, "rb")) == NULL)
+    return 0;
+  ok = fseek(pf, len, SEEK_SET) == 0 && fread(&s, sizeof(s), 1, pf) == 1 &&
+       s == stamp;
+  fclose(pf);
+  return ok;
+}
+
 void delete_folder(const char dir[]) {
   DIR *pf = opendir(dir);
   const struct dirent *next_file;
@@ -34,22 +79,636 @@ void delete_folder(const char dir[]) {
   rmdir(dir);
 }
 
-void *mmap_data(const char path[], size_t nmemb, size_t size) {
+static void *map_file(const char path[], size_t len, int flags) {
   int fd;
-  char mmap_p[MMAP];
   void *mp;
-  sprintf(mmap_p, "./%s", path);
 #ifdef DEBUG
-  printf("mmapping \"%s\"\n", mmap_p);
+  printf("mmapping \"%s\"\n", path);
 #endif
-  fd = open(mmap_p, O_RDONLY);
-  mp = mmap(NULL, nmemb * size, PROT_READ, MAP_SHARED, fd, 0);
+  fd = open(path, O_RDONLY);
+  mp = mmap(NULL, len, PROT_READ, MAP_SHARED | flags, fd, 0);
   if (mp == MAP_FAILED) mp = NULL;
   close(fd);
   return mp;
 }
 
-void print_vec_f(const double *v, int n) {
+void *mmap_data(const char path[], size_t nmemb, size_t size) {
+  return map_file(path, nmemb * size, 0);
+}
+
+/* Same as mmap_data(), but all the pages are read in before returning, so
+ * that a long running process does not pay page faults on its first
+ * accesses */
+void *mmap_populated(const char path[], size_t nmemb, size_t size) {
+  return map_file(path, nmemb * size, MAP_POPULATE);
+}
+
+/* Position dependent sum of the scrambled 64 bit words of a section: a
+ * changed word always changes the sum, and moved words almost always do.
+ * Unlike a CRC it is split over the threads */
+static unsigned long checksum(const unsigned char *data, long size,
+                              int no_threads) {
+  unsigned long sum = 0, w;
+  long i, n = size / 8;
+
+#pragma omp parallel for private(w) reduction(+ : sum) num_threads(no_threads)
+  for (i = 0; i < n; ++i) {
+    memcpy(&w, data + 8 * i, 8);
+    w *= 0x9e3779b97f4a7c15UL;
+    sum += (w ^ (w >> 32)) * (2 * (unsigned long)i + 1);
+  }
+  w = 0;
+  if (size > 8 * n) memcpy(&w, data + 8 * n, size - 8 * n);
+  w *= 0x9e3779b97f4a7c15UL;
+  return sum + (w ^ (w >> 32)) * (2 * (unsigned long)n + 1);
+}
+
+static long align_up(long size) {
+  return (size + CACHE_ALIGN - 1) / CACHE_ALIGN * CACHE_ALIGN;
+}
+
+/* Checksum of the header hdr, its own checksum field aside */
+static unsigned long header_checksum(const Cache_header *hdr) {
+  Cache_header h;
+
+  memcpy(&h, hdr, sizeof(Cache_header));
+  h.hdr_checksum = 0;
+  return checksum((const unsigned char *)&h, sizeof(Cache_header), 1);
+}
+
+/* Whether hdr is the intact header of a complete cache of file_size
+ * bytes, written by this version with the same row offset width: every
+ * section lies after the header and inside the file, and the counts are
+ * consistent. The section sizes are checked against the counts by the
+ * readers, which know the layout */
+static int valid_header(const Cache_header *hdr, long file_size) {
+  const Cache_section *s;
+  int k;
+
+  if (file_size < CACHE_ALIGN ||
+      memcmp(hdr->magic, CACHE_MAGIC, sizeof(hdr->magic)) != 0 ||
+      hdr->version != CACHE_VERSION || hdr->index_width != sizeof(eidx) ||
+      hdr->hdr_checksum != header_checksum(hdr) ||
+      hdr->no_sections < 0 || hdr->no_sections > CACHE_SECTIONS ||
+      hdr->no_nodes < 0 || hdr->no_edges < 0 ||
+      hdr->no_edges > EIDX_MAX || hdr->no_edges > file_size ||
+      hdr->no_danglings < 0 || hdr->no_danglings > hdr->no_nodes ||
+      hdr->no_deltas < 0 || hdr->no_deltas > CACHE_DELTAS)
+    return 0;
+  for (k = 0; k < hdr->no_sections; ++k) {
+    s = &hdr->section[k];
+    if (s->offset < CACHE_ALIGN || s->offset % CACHE_ALIGN != 0 ||
+        s->offset > file_size || s->size < 0 ||
+        s->size > file_size - s->offset)
+      return 0;
+  }
+  return 1;
+}
+
+/* Starts the header of a cache built from the input file src_path */
+void init_cache_header(Cache_header *hdr, const char src_path[]) {
+  struct stat st;
+
+  memset(hdr, 0, sizeof(Cache_header));
+  memcpy(hdr->magic, CACHE_MAGIC, sizeof(hdr->magic));
+  hdr->version = CACHE_VERSION;
+  hdr->index_width = sizeof(eidx);
+  if (src_path != NULL && stat(src_path, &st) == 0) {
+    hdr->src_size = (long)st.st_size;
+    hdr->src_mtime = (long)st.st_mtime;
+  }
+}
+
+/* Writes hdr and the sections data[0 .. hdr->no_sections - 1], whose sizes
+ * are set in hdr, each section starting on a page boundary. The file is
+ * written under a temporary name and then renamed, so that an interrupted
+ * write never leaves a cache that looks complete */
+int write_cache(const char path[], Cache_header *hdr, const void *data[],
+                int no_threads) {
+  static const char zeros[CACHE_ALIGN] = {0};
+  char tmp_path[DNAME + FNAME + 8];
+  FILE *pf;
+  long pos = CACHE_ALIGN, size, pad;
+  int k, err;
+
+  for (k = 0; k < hdr->no_sections; ++k) {
+    hdr->section[k].offset = pos;
+    hdr->section[k].checksum =
+        checksum((const unsigned char *)data[k], hdr->section[k].size,
+                 no_threads);
+    pos += align_up(hdr->section[k].size);
+  }
+  hdr->hdr_checksum = header_checksum(hdr);
+
+  sprintf(tmp_path, "%s.tmp", path);
+  if ((pf = fopen(tmp_path, "wb")) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot create file \"%s\"\n", tmp_path);
+    return EXIT_FAILURE;
+  }
+  err = fwrite(hdr, sizeof(Cache_header), 1, pf) != 1 ||
+        fwrite(zeros, 1, CACHE_ALIGN - sizeof(Cache_header), pf) !=
+            CACHE_ALIGN - sizeof(Cache_header);
+  for (k = 0; k < hdr->no_sections && !err; ++k) {
+    size = hdr->section[k].size;
+    pad = align_up(size) - size;
+    err = fwrite(data[k], 1, size, pf) != (size_t)size ||
+          fwrite(zeros, 1, pad, pf) != (size_t)pad;
+  }
+  err = fclose(pf) != 0 || err;
+
+  if (err || rename(tmp_path, path) != 0) {
+    fprintf(stderr, " [ERROR] Cannot write file \"%s\"\n", path);
+    remove(tmp_path);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/* Tells whether the cache file path can be used for the input file
+ * src_path: it must exist, be complete, and match the size and the
+ * modification time of the input. The checksums are only verified by
+ * map_cache() */
+int cache_check(const char path[], const char src_path[]) {
+  Cache_header hdr;
+  struct stat st;
+  FILE *pf;
+  int ok;
+
+  if (stat(path, &st) == -1 || (pf = fopen(path, "rb")) == NULL)
+    return CACHE_MISSING;
+  ok = fread(&hdr, sizeof(Cache_header), 1, pf) == 1 &&
+       valid_header(&hdr, (long)st.st_size);
+  fclose(pf);
+  if (!ok) return CACHE_INVALID;
+  if (src_path != NULL && stat(src_path, &st) == 0 &&
+      ((long)st.st_size != hdr.src_size ||
+       (long)st.st_mtime != hdr.src_mtime))
+    return CACHE_STALE;
+  return CACHE_OK;
+}
+
+/* Maps the whole cache file path with a single mmap and returns its
+ * header, from which the sections are found; *len is the length of the
+ * mapping. With CACHE_POPULATE every page is read in up front, with
+ * CACHE_SEQUENTIAL the kernel is told the sections are read once in order,
+ * and with CACHE_VERIFY every section is checked against its checksum.
+ * Returns NULL if the file is not a valid cache */
+Cache_header *map_cache(const char path[], int flags, int no_threads,
+                        size_t *len) {
+  Cache_header *hdr;
+  struct stat st;
+  int fd, k;
+
+#ifdef DEBUG
+  printf("mmapping \"%s\"\n", path);
+#endif
+  if ((fd = open(path, O_RDONLY)) == -1 || fstat(fd, &st) == -1 ||
+      st.st_size < (off_t)sizeof(Cache_header)) {
+    if (fd != -1) close(fd);
+    fprintf(stderr, " [ERROR] Cannot map \"%s\"\n", path);
+    return NULL;
+  }
+  hdr = (Cache_header *)mmap(
+      NULL, st.st_size, PROT_READ,
+      MAP_SHARED | (flags & CACHE_POPULATE ? MAP_POPULATE : 0), fd, 0);
+  close(fd);
+  if (hdr == MAP_FAILED) {
+    fprintf(stderr, " [ERROR] Cannot map \"%s\"\n", path);
+    return NULL;
+  }
+  *len = st.st_size;
+
+  /* Both are hints, which the kernel may ignore for a file mapping */
+#ifdef MADV_HUGEPAGE
+  madvise(hdr, *len, MADV_HUGEPAGE);
+#endif
+  if (flags & CACHE_SEQUENTIAL) madvise(hdr, *len, MADV_SEQUENTIAL);
+
+  if (!valid_header(hdr, (long)st.st_size)) {
+    fprintf(stderr, " [ERROR] \"%s\" is not a valid cache\n", path);
+    munmap(hdr, *len);
+    return NULL;
+  }
+  for (k = 0; k < hdr->no_sections && (flags & CACHE_VERIFY); ++k) {
+    if (checksum((const unsigned char *)hdr + hdr->section[k].offset,
+                 hdr->section[k].size,
+                 no_threads) != hdr->section[k].checksum) {
+      fprintf(stderr, " [ERROR] Section %d of \"%s\" is corrupted\n", k,
+              path);
+      munmap(hdr, *len);
+      return NULL;
+    }
+  }
+  return hdr;
+}
+
+/* Stamp of the graph cache hdr, from its header alone: it changes with
+ * the checksum of any section, so with every rebuild or update that
+ * changes the graph */
+unsigned long cache_stamp(const Cache_header *hdr) {
+  unsigned long s = (unsigned long)hdr->no_edges * 0x9e3779b97f4a7c15UL +
+                    (unsigned long)hdr->no_nodes;
+  int k;
+
+  for (k = 0; k < hdr->no_sections; ++k) {
+    s ^= hdr->section[k].checksum + (unsigned long)hdr->section[k].size;
+    s *= 0x9e3779b97f4a7c15UL;
+    s ^= s >> 32;
+  }
+  return s;
+}
+
+/* Stamp of the contents of the file path, 0 if it cannot be read */
+unsigned long file_stamp(const char path[], int no_threads) {
+  struct stat st;
+  unsigned char *data;
+  unsigned long s = 0;
+
+  if (stat(path, &st) == -1) return 0;
+  if (st.st_size > 0) {
+    if ((data = (unsigned char *)map_file(path, st.st_size, 0)) == NULL)
+      return 0;
+    s = checksum(data, (long)st.st_size, no_threads);
+    munmap(data, st.st_size);
+  }
+  return (s ^ (unsigned long)st.st_size) * 0x9e3779b97f4a7c15UL + 1;
+}
+
+/* Whether the delta file of file_stamp() stamp was merged into the cache
+ * of header hdr by one of its last updates */
+int delta_applied(const Cache_header *hdr, unsigned long stamp) {
+  int k;
+
+  for (k = 0; k < hdr->no_deltas; ++k)
+    if (hdr->delta[k] == stamp) return 1;
+  return 0;
+}
+
+/* Records in hdr, the header of the cache of header old updated with the
+ * delta file of file_stamp() stamp, the deltas merged so far. Only the
+ * last CACHE_DELTAS are kept */
+void record_delta(Cache_header *hdr, const Cache_header *old,
+                  unsigned long stamp) {
+  int skip = old->no_deltas == CACHE_DELTAS ? 1 : 0;
+
+  hdr->no_deltas = old->no_deltas - skip;
+  memcpy(hdr->delta, old->delta + skip,
+         sizeof(unsigned long) * hdr->no_deltas);
+  hdr->delta[hdr->no_deltas++] = stamp;
+}
+
+/* Returns the number of edge lines in buf[lo, hi). Comment lines start
+ * with '#' and blank lines are skipped. */
+static long count_edges(const char *buf, size_t lo, size_t hi) {
+  long n = 0;
+  const char *c = buf + lo, *end = buf + hi;
+  const char *nl;
+
+  while (c < end) {
+    if ((nl = memchr(c, '\n', end - c)) == NULL) nl = end;
+    while (c < nl && (*c == ' ' || *c == '\t' || *c == '\r')) ++c;
+    if (c < nl && *c != '#') ++n;
+    c = nl + 1;
+  }
+  return n;
+}
+
+/* Parses the edge lines of buf[lo, hi) into from/to. Progress is added to
+ * done every PROGRESS_STEP edges and printed if report is set. Returns the
+ * largest node id seen, or -1 if a line is malformed. */
+static int parse_edges(const char *buf, size_t lo, size_t hi, int *from,
+                       int *to, eidx *done, eidx no_edges, int report) {
+  const char *c = buf + lo, *end = buf + hi;
+  int max_id = 0;
+  eidx n = 0;
+  int k, id;
+
+  while (c < end) {
+    while (c < end && (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n'))
+      ++c;
+    if (c == end) break;
+    if (*c == '#') {
+      while (c < end && *c != '\n') ++c;
+      continue;
+    }
+    for (k = 0; k < 2; ++k) {
+      while (c < end && (*c == ' ' || *c == '\t')) ++c;
+      if (c == end || *c < '0' || *c > '9') return -1;
+      id = 0;
+      while (c < end && *c >= '0' && *c <= '9') id = id * 10 + (*c++ - '0');
+      if (id > max_id) max_id = id;
+      if (k == 0)
+        from[n] = id;
+      else
+        to[n] = id;
+    }
+    while (c < end && *c != '\n') ++c;
+    if (++n % PROGRESS_STEP == 0) {
+#pragma omp atomic
+      *done += PROGRESS_STEP;
+      if (report) printf("\rEdge %ld/%ld", (long)*done, (long)no_edges);
+    }
+  }
+  return max_id;
+}
+
+int read_edge_list(const char path[], int no_threads, int *no_nodes,
+                   eidx *no_edges, int **from, int **to) {
+  int fd;
+  struct stat st;
+  char *buf;
+  size_t size, body, *bounds;
+  long *offs;
+  int *max_ids;
+  long header_edges = 0;
+  eidx done = 0;
+  int err = 0;
+  int t;
+
+  if ((fd = open(path, O_RDONLY)) == -1 || fstat(fd, &st) == -1) {
+    fprintf(stderr, " [ERROR] Cannot open input file \"%s\"\n", path);
+    return EXIT_FAILURE;
+  }
+  size = (size_t)st.st_size;
+  buf = size > 0 ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+  close(fd);
+  if (buf == MAP_FAILED || buf == NULL) {
+    fprintf(stderr, " [ERROR] Cannot map input file \"%s\"\n", path);
+    return EXIT_FAILURE;
+  }
+  madvise(buf, size, MADV_SEQUENTIAL);
+
+  /* Parsing input file header: the comment lines before the first edge */
+  *no_nodes = 0;
+  body = 0;
+  while (body < size && buf[body] == '#') {
+    sscanf(buf + body, "# Nodes: %d Edges: %ld", no_nodes, &header_edges);
+    while (body < size && buf[body] != '\n') ++body;
+    ++body;
+  }
+  if (body > size) body = size;
+
+  /* Splitting the body into newline-aligned chunks, one per thread */
+  bounds = (size_t *)malloc(sizeof(size_t) * (no_threads + 1));
+  offs = (long *)malloc(sizeof(long) * (no_threads + 1));
+  max_ids = (int *)malloc(sizeof(int) * no_threads);
+  bounds[0] = body;
+  for (t = 1; t < no_threads; ++t) {
+    bounds[t] = body + (size - body) / no_threads * t;
+    if (bounds[t] < bounds[t - 1]) bounds[t] = bounds[t - 1];
+    while (bounds[t] > body && bounds[t] < size && buf[bounds[t] - 1] != '\n')
+      ++bounds[t];
+  }
+  bounds[no_threads] = size;
+
+  offs[0] = 0;
+#pragma omp parallel for num_threads(no_threads)
+  for (t = 0; t < no_threads; ++t)
+    offs[t + 1] = count_edges(buf, bounds[t], bounds[t + 1]);
+  for (t = 0; t < no_threads; ++t) offs[t + 1] += offs[t];
+  if (offs[no_threads] > EIDX_MAX) {
+    fprintf(stderr,
+            " [ERROR] \"%s\" has %ld edges, too many for this build: "
+            "rebuild with \"make CFLAGS=-DLARGE\"\n",
+            path, offs[no_threads]);
+    munmap(buf, size);
+    free(bounds);
+    free(offs);
+    free(max_ids);
+    return EXIT_FAILURE;
+  }
+  *no_edges = (eidx)offs[no_threads];
+
+  *from = (int *)malloc(sizeof(int) * (size_t)*no_edges);
+  *to = (int *)malloc(sizeof(int) * (size_t)*no_edges);
+#pragma omp parallel for num_threads(no_threads)
+  for (t = 0; t < no_threads; ++t)
+    max_ids[t] = parse_edges(buf, bounds[t], bounds[t + 1], *from + offs[t],
+                             *to + offs[t], &done, *no_edges, t == 0);
+  printf("\rEdge %ld/%ld\n", (long)*no_edges, (long)*no_edges);
+
+  /* Node ids are not always contiguous, make room for the largest one */
+  for (t = 0; t < no_threads; ++t) {
+    if (max_ids[t] < 0) err = 1;
+    if (max_ids[t] >= *no_nodes) *no_nodes = max_ids[t] + 1;
+  }
+  if (header_edges != *no_edges)
+    printf("Header declares %ld edges, %ld were read\n", header_edges,
+           (long)*no_edges);
+
+  munmap(buf, size);
+  free(bounds);
+  free(offs);
+  free(max_ids);
+
+  if (err) {
+    fprintf(stderr, " [ERROR] Malformed edge in input file \"%s\"\n", path);
+    free(*from);
+    free(*to);
+    *from = NULL;
+    *to = NULL;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/* Reads an edge delta file. Every line is "+ u v", which inserts the edge
+ * u -> v, or "- u v", which deletes one copy of it; '#' starts a comment.
+ * Ids are the ones of the input file and are mapped through perm. Ids past
+ * the current graph are new nodes, kept as they are, and *no_nodes grows to
+ * fit them. Deletions of edges between unknown nodes are dropped */
+int read_edge_delta(const char path[], const int *perm, int *no_nodes,
+                    int *no_ins, int **ins_from, int **ins_to, int *no_del,
+                    int **del_from, int **del_to) {
+  FILE *pf;
+  char *s = NULL, *c, *end;
+  char op;
+  size_t slen = 0;
+  int cap_ins = 1024, cap_del = 1024;
+  int old_nodes = *no_nodes;
+  long u, v;
+  int line = 0;
+  int err = 0;
+
+  if ((pf = fopen(path, "r")) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot open delta file \"%s\"\n", path);
+    return EXIT_FAILURE;
+  }
+
+  *no_ins = *no_del = 0;
+  *ins_from = (int *)malloc(sizeof(int) * cap_ins);
+  *ins_to = (int *)malloc(sizeof(int) * cap_ins);
+  *del_from = (int *)malloc(sizeof(int) * cap_del);
+  *del_to = (int *)malloc(sizeof(int) * cap_del);
+  while (!err && getline(&s, &slen, pf) != -1) {
+    ++line;
+    for (c = s; *c == ' ' || *c == '\t' || *c == '\r'; ++c)
+      ;
+    if (*c == '#' || *c == '\n' || *c == '\0') continue;
+
+    op = *c++;
+    err = op != '+' && op != '-';
+    if (!err) {
+      u = strtol(c, &end, 10);
+      err = end == c || u < 0 || u >= INT_MAX;
+      c = end;
+    }
+    if (!err) {
+      v = strtol(c, &end, 10);
+      err = end == c || v < 0 || v >= INT_MAX;
+    }
+    if (err) {
+      fprintf(stderr, " [ERROR] Malformed line %d in delta file \"%s\"\n",
+              line, path);
+      break;
+    }
+
+    if (op == '+') {
+      if (*no_ins == cap_ins) {
+        cap_ins *= 2;
+        *ins_from = (int *)realloc(*ins_from, sizeof(int) * cap_ins);
+        *ins_to = (int *)realloc(*ins_to, sizeof(int) * cap_ins);
+      }
+      (*ins_from)[*no_ins] = perm != NULL && u < old_nodes ? perm[u] : (int)u;
+      (*ins_to)[(*no_ins)++] = perm != NULL && v < old_nodes ? perm[v] : (int)v;
+      if (u >= *no_nodes) *no_nodes = (int)u + 1;
+      if (v >= *no_nodes) *no_nodes = (int)v + 1;
+    } else if (u < old_nodes && v < old_nodes) {
+      if (*no_del == cap_del) {
+        cap_del *= 2;
+        *del_from = (int *)realloc(*del_from, sizeof(int) * cap_del);
+        *del_to = (int *)realloc(*del_to, sizeof(int) * cap_del);
+      }
+      (*del_from)[*no_del] = perm != NULL ? perm[u] : (int)u;
+      (*del_to)[(*no_del)++] = perm != NULL ? perm[v] : (int)v;
+    }
+  }
+  fclose(pf);
+  free(s);
+
+  if (err) {
+    free(*ins_from);
+    free(*ins_to);
+    free(*del_from);
+    free(*del_to);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/* Writes a score vector as an array of doubles, whatever the precision it
+ * was computed in, converting a block at a time. If the nodes have been
+ * reordered, perm maps every original id to its position in v. The write
+ * is recorded as the metrics phase phase. A file that cannot be written
+ * completely is removed */
+int write_scores(const char path[], const real *v, int n, const int *perm,
+                 const char *phase) {
+  FILE *pdata;
+  double block[4096];
+  int i, j, len;
+  int err = 0;
+  Metrics_mark begin;
+
+  metrics_mark(&begin);
+  if ((pdata = fopen(path, "wb")) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot create file \"%s\"\n", path);
+    return EXIT_FAILURE;
+  }
+  for (i = 0; i < n && !err; i += len) {
+    len = n - i < 4096 ? n - i : 4096;
+    for (j = 0; j < len; ++j)
+      block[j] = (double)v[perm != NULL ? perm[i + j] : i + j];
+    err = fwrite(block, sizeof(double), len, pdata) != (size_t)len;
+  }
+  err = fclose(pdata) != 0 || err;
+  if (err) {
+    fprintf(stderr, " [ERROR] Cannot write file \"%s\"\n", path);
+    remove(path);
+    return EXIT_FAILURE;
+  }
+  metrics_phase(phase, &begin);
+  return EXIT_SUCCESS;
+}
+
+/* Reads back a score vector written by write_scores(). The file may hold
+ * fewer than n values, e.g. when the graph has grown since: the entries it
+ * does not cover are left untouched. Returns the number of values read, or
+ * -1 if the file cannot be opened */
+int read_scores(const char path[], real *v, int n, const int *perm) {
+  FILE *pdata;
+  double block[4096];
+  int i, j, len;
+
+  if ((pdata = fopen(path, "rb")) == NULL) return -1;
+  for (i = 0; i < n; i += len) {
+    len = n - i < 4096 ? n - i : 4096;
+    if ((len = (int)fread(block, sizeof(double), len, pdata)) == 0) break;
+    for (j = 0; j < len; ++j)
+      v[perm != NULL ? perm[i + j] : i + j] = (real)block[j];
+  }
+  fclose(pdata);
+  return i;
+}
+
+/* Prints how far v is from the reference vector of doubles stored in
+ * ref_path: the largest absolute difference and how many of the top
+ * CMP_TOP_K nodes of the two vectors are the same. perm is as in
+ * write_scores() */
+void compare_scores(const real *v, const char ref_path[], int n,
+                    const int *perm, int no_threads) {
+  const double *ref;
+  real *ref_r;
+  int *top_v, *top_ref;
+  char *in_top;
+  double diff, max_diff = 0.;
+  int top_K = n < CMP_TOP_K ? n : CMP_TOP_K;
+  int overlap = 0;
+  int i, k;
+  struct stat st;
+
+  /* A reference of another graph, or a truncated one, would be read past
+   * its end */
+  if (stat(ref_path, &st) == 0 &&
+      (long)st.st_size != (long)n * (long)sizeof(double)) {
+    fprintf(stderr,
+            " [ERROR] Reference file \"%s\" holds %ld bytes, not the %ld "
+            "of %d scores\n",
+            ref_path, (long)st.st_size, (long)n * (long)sizeof(double), n);
+    return;
+  }
+  if ((ref = (const double *)mmap_data(ref_path, n, sizeof(double))) ==
+      NULL) {
+    fprintf(stderr, " [ERROR] Cannot read reference file \"%s\"\n",
+            ref_path);
+    return;
+  }
+
+  ref_r = (real *)calloc(n, sizeof(real));
+  for (i = 0; i < n; ++i) {
+    k = perm != NULL ? perm[i] : i;
+    diff = fabs((double)v[k] - ref[i]);
+    if (diff > max_diff) max_diff = diff;
+    ref_r[k] = (real)ref[i];
+  }
+
+  top_v = index_sort_top_K(v, n, top_K, no_threads);
+  top_ref = index_sort_top_K(ref_r, n, top_K, no_threads);
+  in_top = (char *)calloc(n, sizeof(char));
+  for (i = 0; i < top_K; ++i) in_top[top_ref[i]] = 1;
+  for (i = 0; i < top_K; ++i) overlap += in_top[top_v[i]];
+
+  printf("Compared with \"%s\":\n", ref_path);
+  printf("max |v - ref| = %e\n", max_diff);
+  printf("top-%d overlap = %d/%d\n\n", top_K, overlap, top_K);
+
+  munmap((void *)ref, n * sizeof(double));
+  free(ref_r);
+  free(top_v);
+  free(top_ref);
+  free(in_top);
+}
+
+void print_vec_f(const real *v, int n) {
   int i;
   printf("[ ");
   for (i = 0; i < n; ++i) printf("%.3f ", v[i]);
@@ -63,107 +722,746 @@ void print_vec_d(const int *v, int n) {
   printf("]\n");
 }
 
-void double_merge(int *from, int *to, int lo, int mid, int hi) {
-  int *FL, *TL;
-  int *FR, *TR;
-  int i, j;
-  int NL, NR;
+/* Key blocks of the first pass of counting_sort(), when histograms of all
+ * the keys in every thread would take more room than the pairs */
+#define SORT_BLOCKS (1 << 16)
 
-  NL = mid - lo;
-  NR = hi - mid;
+/* Stable counting sort of the pairs (keys[i], vals[i]) by key. On return
+ * ptr[k] is the offset of the first pair with key k (ptr has no_keys + 1
+ * entries) and the pairs are stored in vals_out/keys_out in key order;
+ * keys_out may be NULL. Each thread histograms a contiguous block of the
+ * input, so the scatter keeps the input order within every key. With many
+ * keys and threads the histograms only count blocks of width keys: the
+ * pairs are scattered by block into a buffer, then every block is sorted
+ * on its own, so the memory no longer grows with threads x keys */
+static void counting_sort(const int *keys, const int *vals, eidx n,
+                          int no_keys, int no_threads, eidx *ptr,
+                          int *keys_out, int *vals_out) {
+  int width = 1, no_blocks = no_keys;
+  int *buf_keys = keys_out, *buf_vals = vals_out;
+  eidx *hist, *start, *tot;
+  eidx off, c;
+  int t;
+
+  if ((double)no_threads * no_keys * sizeof(eidx) >
+          (double)n * 2 * sizeof(int) &&
+      no_keys > SORT_BLOCKS) {
+    width = (no_keys + SORT_BLOCKS - 1) / SORT_BLOCKS;
+    no_blocks = (no_keys + width - 1) / width;
+    buf_keys = (int *)malloc(sizeof(int) * (size_t)n);
+    buf_vals = (int *)malloc(sizeof(int) * (size_t)n);
+  }
+  hist = (eidx *)calloc((size_t)no_threads * no_blocks, sizeof(eidx));
+  start = width == 1 ? ptr : (eidx *)malloc(sizeof(eidx) * (no_blocks + 1));
+  tot = (eidx *)malloc(sizeof(eidx) * no_threads);
 
-  FL = (int *)malloc(sizeof(int) * NL);
-  TL = (int *)malloc(sizeof(int) * NL);
-  FR = (int *)malloc(sizeof(int) * NR);
-  TR = (int *)malloc(sizeof(int) * NR);
+#pragma omp parallel for schedule(static, 1) num_threads(no_threads)
+  for (t = 0; t < no_threads; ++t) {
+    eidx *h = hist + (size_t)t * no_blocks;
+    eidx i;
+    eidx lo = (eidx)((double)n * t / no_threads);
+    eidx hi = (eidx)((double)n * (t + 1) / no_threads);
 
-  for (i = 0; i < NL; ++i) {
-    FL[i] = from[lo + i];
-    TL[i] = to[lo + i];
+    for (i = lo; i < hi; ++i) ++h[keys[i] / width];
   }
 
-  for (j = 0; j < NR; ++j) {
-    FR[j] = from[mid + j];
-    TR[j] = to[mid + j];
+  /* Exclusive prefix sum, block-major then thread order: every thread sums
+   * a range of blocks, and the ranges are then offset */
+#pragma omp parallel for schedule(static, 1) num_threads(no_threads)
+  for (t = 0; t < no_threads; ++t) {
+    int lo = (int)((double)no_blocks * t / no_threads);
+    int hi = (int)((double)no_blocks * (t + 1) / no_threads);
+    int b, u;
+    eidx sum = 0;
+
+    for (b = lo; b < hi; ++b)
+      for (u = 0; u < no_threads; ++u) sum += hist[(size_t)u * no_blocks + b];
+    tot[t] = sum;
+  }
+  off = 0;
+  for (t = 0; t < no_threads; ++t) {
+    c = tot[t];
+    tot[t] = off;
+    off += c;
+  }
+#pragma omp parallel for schedule(static, 1) num_threads(no_threads)
+  for (t = 0; t < no_threads; ++t) {
+    int lo = (int)((double)no_blocks * t / no_threads);
+    int hi = (int)((double)no_blocks * (t + 1) / no_threads);
+    int b, u;
+    eidx pos = tot[t], cnt;
+
+    for (b = lo; b < hi; ++b) {
+      start[b] = pos;
+      for (u = 0; u < no_threads; ++u) {
+        cnt = hist[(size_t)u * no_blocks + b];
+        hist[(size_t)u * no_blocks + b] = pos;
+        pos += cnt;
+      }
+    }
+  }
+  start[no_blocks] = n;
+
+#pragma omp parallel for schedule(static, 1) num_threads(no_threads)
+  for (t = 0; t < no_threads; ++t) {
+    eidx *h = hist + (size_t)t * no_blocks;
+    eidx i, pos;
+    eidx lo = (eidx)((double)n * t / no_threads);
+    eidx hi = (eidx)((double)n * (t + 1) / no_threads);
+
+    for (i = lo; i < hi; ++i) {
+      pos = h[keys[i] / width]++;
+      buf_vals[pos] = vals[i];
+      if (buf_keys != NULL) buf_keys[pos] = keys[i];
+    }
   }
 
-  i = 0;
-  j = 0;
-  while (i < NL && j < NR) {
-    if (TL[i] < TR[j] || (TL[i] == TR[j] && FL[i] <= FR[j])) {
-      from[lo + i + j] = FL[i];
-      to[lo + i + j] = TL[i];
-      ++i;
+  /* Every block of keys sorted on its own, the blocks of hubs being
+   * larger */
+  if (width > 1) {
+#pragma omp parallel num_threads(no_threads)
+    {
+      eidx *cur = (eidx *)malloc(sizeof(eidx) * width);
+      eidx i, pos;
+      int b, k, lo, len;
+
+#pragma omp for schedule(dynamic, 16)
+      for (b = 0; b < no_blocks; ++b) {
+        lo = b * width;
+        len = no_keys - lo < width ? no_keys - lo : width;
+        memset(cur, 0, sizeof(eidx) * len);
+        for (i = start[b]; i < start[b + 1]; ++i) ++cur[buf_keys[i] - lo];
+        pos = start[b];
+        for (k = 0; k < len; ++k) {
+          ptr[lo + k] = pos;
+          pos += cur[k];
+          cur[k] = ptr[lo + k];
+        }
+        for (i = start[b]; i < start[b + 1]; ++i) {
+          pos = cur[buf_keys[i] - lo]++;
+          vals_out[pos] = buf_vals[i];
+          if (keys_out != NULL) keys_out[pos] = buf_keys[i];
+        }
+      }
+      free(cur);
+    }
+    ptr[no_keys] = n;
+    free(start);
+    free(buf_keys);
+    free(buf_vals);
+  }
+
+  free(hist);
+  free(tot);
+}
+
+/* Builds the CSR matrix holding an entry (rows[i], cols[i]) for every edge.
+ * When sorted is set the column indices of every row are increasing. */
+void build_csr(const int *rows, const int *cols, int no_nodes, eidx no_edges,
+               int sorted, int no_threads, eidx *row_ptr, int *col_ind) {
+  int *tmp_rows, *tmp_cols;
+  eidx *tmp_ptr;
+
+  if (!sorted) {
+    counting_sort(rows, cols, no_edges, no_nodes, no_threads, row_ptr, NULL,
+                  col_ind);
+    return;
+  }
+
+  /* LSD radix sort with node-sized digits: order by column first, then a
+   * stable pass by row leaves every adjacency list sorted */
+  tmp_rows = (int *)malloc(sizeof(int) * (size_t)no_edges);
+  tmp_cols = (int *)malloc(sizeof(int) * (size_t)no_edges);
+  tmp_ptr = (eidx *)malloc(sizeof(eidx) * (no_nodes + 1));
+  counting_sort(cols, rows, no_edges, no_nodes, no_threads, tmp_ptr, tmp_cols,
+                tmp_rows);
+  free(tmp_ptr);
+  counting_sort(tmp_rows, tmp_cols, no_edges, no_nodes, no_threads, row_ptr,
+                NULL, col_ind);
+  free(tmp_rows);
+  free(tmp_cols);
+}
+
+/* Applies a delta to the CSR matrix (row_ptr, col_ind) of no_nodes rows,
+ * into a new matrix of new_nodes >= no_nodes rows: one copy of every
+ * deleted (row, col) pair is removed and the inserted pairs are appended to
+ * their row, or merged into it if sorted is set. The deletions that match
+ * no entry are dropped from del_rows/del_cols and *no_del is updated. The
+ * new matrix is allocated in *new_ptr and *new_ind, its number of entries
+ * is returned */
+eidx merge_csr(const eidx *row_ptr, const int *col_ind, int no_nodes,
+               int new_nodes, const int *ins_rows, const int *ins_cols,
+               int no_ins, int *del_rows, int *del_cols, int *no_del,
+               int sorted, int no_threads, eidx **new_ptr, int **new_ind) {
+  char *gone = (char *)calloc(row_ptr[no_nodes] > 0 ? row_ptr[no_nodes] : 1,
+                              sizeof(char));
+  int *removed = (int *)calloc(new_nodes, sizeof(int));
+  eidx *ins_ptr = (eidx *)malloc(sizeof(eidx) * (new_nodes + 1));
+  int *ins_ind = (int *)malloc(sizeof(int) * (no_ins > 0 ? no_ins : 1));
+  eidx *ptr;
+  int *ind;
+  eidx ci, n;
+  int ri, k;
+
+  /* Rows are short on average, so a deletion scans its row for the first
+   * copy of the edge that is still there */
+  n = 0;
+  for (k = 0; k < *no_del; ++k) {
+    ri = del_rows[k];
+    for (ci = row_ptr[ri]; ci < row_ptr[ri + 1]; ++ci)
+      if (col_ind[ci] == del_cols[k] && !gone[ci]) break;
+    if (ci == row_ptr[ri + 1]) continue;
+    gone[ci] = 1;
+    ++removed[ri];
+    del_rows[n] = ri;
+    del_cols[n++] = del_cols[k];
+  }
+  *no_del = (int)n;
+
+  build_csr(ins_rows, ins_cols, new_nodes, no_ins, sorted, no_threads, ins_ptr,
+            ins_ind);
+
+  ptr = (eidx *)malloc(sizeof(eidx) * (new_nodes + 1));
+  ptr[0] = 0;
+  for (ri = 0; ri < new_nodes; ++ri) {
+    n = ri < no_nodes ? row_ptr[ri + 1] - row_ptr[ri] - removed[ri] : 0;
+    ptr[ri + 1] = ptr[ri] + n + ins_ptr[ri + 1] - ins_ptr[ri];
+  }
+  ind = (int *)malloc(sizeof(int) *
+                      (ptr[new_nodes] > 0 ? (size_t)ptr[new_nodes] : 1));
+
+#pragma omp parallel for schedule(dynamic, 4096) num_threads(no_threads)
+  for (ri = 0; ri < new_nodes; ++ri) {
+    eidx lo = ri < no_nodes ? row_ptr[ri] : 0;
+    eidx hi = ri < no_nodes ? row_ptr[ri + 1] : 0;
+    eidx i = ptr[ri], j = ins_ptr[ri];
+    eidx c;
+
+    if (!sorted && removed[ri] == 0) {
+      memcpy(ind + i, col_ind + lo, sizeof(int) * (hi - lo));
+      i += hi - lo;
     } else {
-      from[lo + i + j] = FR[j];
-      to[lo + i + j] = TR[j];
-      ++j;
+      for (c = lo; c < hi; ++c) {
+        if (gone[c]) continue;
+        while (sorted && j < ins_ptr[ri + 1] && ins_ind[j] < col_ind[c])
+          ind[i++] = ins_ind[j++];
+        ind[i++] = col_ind[c];
+      }
+    }
+    while (j < ins_ptr[ri + 1]) ind[i++] = ins_ind[j++];
+  }
+
+  free(gone);
+  free(removed);
+  free(ins_ptr);
+  free(ins_ind);
+  *new_ptr = ptr;
+  *new_ind = ind;
+  return ptr[new_nodes];
+}
+
+/* Whether node i ranks before node j: a higher score, or the same score
+ * and a lower id, so that the ranking is a total order. The ids are those
+ * of ids when it is not NULL */
+#define RANK_ID(ids, i) ((ids) != NULL ? (ids)[i] : (i))
+#define RANKS_BEFORE(v, ids, i, j) \
+  ((v)[i] > (v)[j] ||              \
+   ((v)[i] == (v)[j] && RANK_ID(ids, i) < RANK_ID(ids, j)))
+
+/* Restores the heap property below heap[k]. The heap is by rank, the root
+ * being the worst node kept */
+static void sift_down(const real *v, const int *ids, int *heap, int len,
+                      int k) {
+  int c, tmp;
+
+  while ((c = 2 * k + 1) < len) {
+    if (c + 1 < len && RANKS_BEFORE(v, ids, heap[c], heap[c + 1])) ++c;
+    if (!RANKS_BEFORE(v, ids, heap[k], heap[c])) break;
+    tmp = heap[k];
+    heap[k] = heap[c];
+    heap[c] = tmp;
+    k = c;
+  }
+}
+
+/* Keeps in heap, of *len <= top_K nodes, the top_K best of them and of
+ * the nodes cand[0 .. n - 1] */
+static void heap_select(const real *v, const int *ids, int *heap, int *len,
+                        int top_K, const int *cand, long n) {
+  long i;
+  int k;
+
+  for (i = 0; i < n && *len < top_K; ++i) heap[(*len)++] = cand[i];
+  for (k = *len / 2 - 1; k >= 0; --k) sift_down(v, ids, heap, *len, k);
+  for (; i < n; ++i) {
+    if (RANKS_BEFORE(v, ids, cand[i], heap[0])) {
+      heap[0] = cand[i];
+      sift_down(v, ids, heap, *len, 0);
     }
   }
+}
 
-  while (i < NL) {
-    from[lo + i + j] = FL[i];
-    to[lo + i + j] = TL[i];
-    ++i;
+/* Returns the top_K best nodes of v, best first, in O(n log K). Ties go to
+ * the lowest id, ids[i] being the id of node i if ids is not NULL. Every
+ * thread keeps a heap of the best nodes of its range of v, then the heaps
+ * are merged into one, which is finally sorted in place */
+int *select_top_K(const real *v, const int *ids, int n, int top_K,
+                  int no_threads) {
+  int *heap, *all, *len;
+  int t, k, m, tmp;
+
+  if (top_K > n) top_K = n;
+  if (top_K < 0) top_K = 0;
+  if (no_threads < 1) no_threads = 1;
+  /* Small inputs are not worth the threads */
+  if ((long)n < 65536L * no_threads) no_threads = 1;
+
+  heap = (int *)malloc(sizeof(int) * (top_K > 0 ? top_K : 1));
+  all = (int *)malloc(sizeof(int) * ((size_t)no_threads * top_K + 1));
+  len = (int *)calloc(no_threads, sizeof(int));
+
+#pragma omp parallel for schedule(static, 1) num_threads(no_threads)
+  for (t = 0; t < no_threads; ++t) {
+    int lo = (int)((long)n * t / no_threads);
+    int hi = (int)((long)n * (t + 1) / no_threads);
+    int *mine = all + (size_t)t * top_K;
+    int i, j;
+
+    for (i = lo; i < hi && len[t] < top_K; ++i) mine[len[t]++] = i;
+    for (j = len[t] / 2 - 1; j >= 0; --j)
+      sift_down(v, ids, mine, len[t], j);
+    for (; i < hi; ++i) {
+      if (RANKS_BEFORE(v, ids, i, mine[0])) {
+        mine[0] = i;
+        sift_down(v, ids, mine, len[t], 0);
+      }
+    }
   }
 
-  while (j < NR) {
-    from[lo + i + j] = FR[j];
-    to[lo + i + j] = TR[j];
-    ++j;
+  m = 0;
+  for (t = 0; t < no_threads; ++t)
+    heap_select(v, ids, heap, &m, top_K, all + (size_t)t * top_K, len[t]);
+
+  /* Heapsort: the worst node goes last, and so on */
+  for (k = m - 1; k > 0; --k) {
+    tmp = heap[0];
+    heap[0] = heap[k];
+    heap[k] = tmp;
+    sift_down(v, ids, heap, k, 0);
   }
 
-  free(FL);
-  free(TL);
-  free(FR);
-  free(TR);
+  free(all);
+  free(len);
+  return heap;
 }
 
-void double_merge_sort(int *from, int *to, int lo, int hi) {
-  if (hi - lo > 1) {
-    int mid = (lo + hi) / 2;
-    double_merge_sort(from, to, lo, mid);
-    double_merge_sort(from, to, mid, hi);
-    double_merge(from, to, lo, mid, hi);
+/* The top_K best nodes of v, the worst of them first */
+int *index_sort_top_K(const real *v, int n, int top_K, int no_threads) {
+  int *idx = select_top_K(v, NULL, n, top_K, no_threads);
+  int i, tmp;
+
+  if (top_K > n) top_K = n;
+  for (i = 0; i < top_K / 2; ++i) {
+    tmp = idx[i];
+    idx[i] = idx[top_K - 1 - i];
+    idx[top_K - 1 - i] = tmp;
   }
+  return idx;
 }
 
-void sort_input_data(int *from, int *to, int n) {
-  double_merge_sort(from, to, 0, n);
+/* Writes the top_K best nodes of v, best first, with the node ids of the
+ * input file (see write_scores() for perm): to path as an int K followed
+ * by the K node ids, as ints, and by their K scores, as doubles, and to
+ * csv_path as "node,score" lines. The write is recorded as the metrics
+ * phase phase */
+int write_top_K(const char path[], const char csv_path[], const real *v,
+                int n, const int *perm, int top_K, int no_threads,
+                const char *phase) {
+  FILE *pf, *pcsv;
+  int *top;
+  int *ids = NULL;
+  double *scores;
+  int i, k;
+  int err;
+  Metrics_mark begin;
+
+  metrics_mark(&begin);
+  if (top_K > n) top_K = n;
+  if (top_K < 0) top_K = 0;
+
+  /* perm maps the other way, and ties are broken on the input ids */
+  if (perm != NULL) {
+    ids = (int *)malloc(sizeof(int) * n);
+#pragma omp parallel for num_threads(no_threads)
+    for (i = 0; i < n; ++i) ids[perm[i]] = i;
+  }
+  top = select_top_K(v, ids, n, top_K, no_threads);
+  scores = (double *)malloc(sizeof(double) * (top_K > 0 ? top_K : 1));
+  for (k = 0; k < top_K; ++k) {
+    scores[k] = (double)v[top[k]];
+    top[k] = RANK_ID(ids, top[k]);
+  }
+
+  if ((pf = fopen(path, "wb")) == NULL ||
+      (pcsv = fopen(csv_path, "w")) == NULL) {
+    fprintf(stderr, " [ERROR] Cannot create file \"%s\"\n",
+            pf == NULL ? path : csv_path);
+    if (pf != NULL) fclose(pf);
+    free(top);
+    free(ids);
+    free(scores);
+    return EXIT_FAILURE;
+  }
+  err = fwrite(&top_K, sizeof(int), 1, pf) != 1 ||
+        fwrite(top, sizeof(int), top_K, pf) != (size_t)top_K ||
+        fwrite(scores, sizeof(double), top_K, pf) != (size_t)top_K;
+  err = fclose(pf) != 0 || err;
+  err = fprintf(pcsv, "node,score\n") < 0 || err;
+  for (k = 0; k < top_K && !err; ++k)
+    err = fprintf(pcsv, "%d,%.10e\n", top[k], scores[k]) < 0;
+  err = fclose(pcsv) != 0 || err;
+  if (err) fprintf(stderr, " [ERROR] Cannot write file \"%s\"\n", path);
+
+  free(top);
+  free(ids);
+  free(scores);
+  metrics_phase(phase, &begin);
+  return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* Splits the rows of a CSR matrix into no_parts contiguous ranges holding
+ * roughly the same number of non-zeros. Part t covers rows
+ * [bounds[t], bounds[t + 1]), so bounds must hold no_parts + 1 entries. */
+void partition_rows(const eidx *row_ptr, int no_nodes, int no_parts,
+                    int *bounds) {
+  int t;
+  int lo, hi, mid;
+  double target;
+
+  bounds[0] = 0;
+  for (t = 1; t < no_parts; ++t) {
+    target = (double)row_ptr[no_nodes] * t / no_parts;
+    /* First row whose offset reaches the target */
+    lo = bounds[t - 1];
+    hi = no_nodes;
+    while (lo < hi) {
+      mid = lo + (hi - lo) / 2;
+      if ((double)row_ptr[mid] < target)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    bounds[t] = lo;
+  }
+  bounds[no_parts] = no_nodes;
 }
 
-#define SWAP(v, i, j) \
-  do {                \
-    int tmp = v[i];   \
-    v[i] = v[j];       \
-    v[j] = tmp;        \
-  } while (0)
+static int cmp_int(const void *x, const void *y) {
+  int a = *(const int *)x, b = *(const int *)y;
+  return (a > b) - (a < b);
+}
 
-int *index_sort_top_K(const double *v, int n, int top_K) {
-  int i, j;
-  int *idx = (int *)malloc(top_K * sizeof(int));
+/* Gap/varint encodes the rows of a CSR matrix, see VB_NEXT */
+static int write_vb_csr(const char row_off_path[], const char data_path[],
+                        const eidx *row_ptr, const int *col_ind,
+                        int no_nodes, unsigned long stamp) {
+  long *row_off = (long *)malloc(sizeof(long) * (no_nodes + 1));
+  unsigned char *data =
+      (unsigned char *)malloc(5 * (size_t)row_ptr[no_nodes] + 1);
+  int *row = NULL;
+  eidx max_deg = 0;
+  eidx k, len;
+  int ri, prev;
+  unsigned int gap;
+  long pos = 0;
+  int err;
 
-  for (i = 0; i < top_K; ++i) {
-    idx[i] = i;
-    for (j = i; j > 0; --j) {
-      if (v[idx[j - 1]] <= v[idx[j]]) {
-        break;
+  for (ri = 0; ri < no_nodes; ++ri)
+    if (row_ptr[ri + 1] - row_ptr[ri] > max_deg)
+      max_deg = row_ptr[ri + 1] - row_ptr[ri];
+  row = (int *)malloc(sizeof(int) * ((size_t)max_deg + 1));
+
+  for (ri = 0; ri < no_nodes; ++ri) {
+    row_off[ri] = pos;
+    len = row_ptr[ri + 1] - row_ptr[ri];
+    memcpy(row, col_ind + row_ptr[ri], sizeof(int) * len);
+    qsort(row, len, sizeof(int), cmp_int);
+    prev = 0;
+    for (k = 0; k < len; ++k) {
+      gap = (unsigned int)(row[k] - prev);
+      prev = row[k];
+      while (gap >= 0x80) {
+        data[pos++] = (unsigned char)(gap | 0x80);
+        gap >>= 7;
       }
-      SWAP(idx, j, j - 1);
+      data[pos++] = (unsigned char)gap;
     }
   }
+  row_off[no_nodes] = pos;
 
-  for (; i < n; ++i) {
-    if (v[idx[0]] < v[i]) {
-      idx[0] = i;
-      for (j = 1; j < top_K; ++j) {
-        if (v[idx[j - 1]] < v[idx[j]]) {
-          break;
+  /* row_off, written last, is the one stamped */
+  err = (write_data(data_path, data, 1, pos) == EXIT_FAILURE) ||
+        (write_stamped(row_off_path, row_off, no_nodes + 1, sizeof(long),
+                       stamp) == EXIT_FAILURE);
+  if (err) {
+    remove(row_off_path);
+    remove(data_path);
+  } else {
+    printf("Adjacency compressed from %ld to %ld bytes\n",
+           (long)row_ptr[no_nodes] * (long)sizeof(int), pos);
+  }
+
+  free(row_off);
+  free(data);
+  free(row);
+  return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* Maps the compressed form of a CSR matrix, building it from the plain one
+ * the first time it is requested, and again when it is not stamped with
+ * stamp, the cache_stamp() of the matrix. The build is recorded as the
+ * metrics phase "compress" */
+int load_vb_csr(const char row_off_path[], const char data_path[],
+                const eidx *row_ptr, const int *col_ind, int no_nodes,
+                unsigned long stamp, long **row_off, unsigned char **data) {
+  struct stat st;
+  Metrics_mark begin;
+
+  if (stat(data_path, &st) == -1 ||
+      !check_stamp(row_off_path, sizeof(long) * (no_nodes + 1L), stamp)) {
+    printf("Compressing adjacency lists...\n");
+    metrics_mark(&begin);
+    if (write_vb_csr(row_off_path, data_path, row_ptr, col_ind, no_nodes,
+                     stamp) == EXIT_FAILURE)
+      return EXIT_FAILURE;
+    metrics_phase("compress", &begin);
+  }
+
+  if ((*row_off = (long *)mmap_data(row_off_path, sizeof(long),
+                                    no_nodes + 1)) == NULL)
+    return EXIT_FAILURE;
+  /* An empty graph has nothing to map */
+  if ((*row_off)[no_nodes] == 0) {
+    *data = NULL;
+    return EXIT_SUCCESS;
+  }
+  if ((*data = (unsigned char *)mmap_data(data_path, 1,
+                                          (*row_off)[no_nodes])) == NULL) {
+    munmap(*row_off, sizeof(long) * (no_nodes + 1));
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+typedef struct {
+  int deg;
+  int node;
+} Deg_entry;
+
+static int cmp_deg(const void *x, const void *y) {
+  const Deg_entry *a = (const Deg_entry *)x, *b = (const Deg_entry *)y;
+
+  if (a->deg != b->deg) return (a->deg > b->deg) - (a->deg < b->deg);
+  return (a->node > b->node) - (a->node < b->node);
+}
+
+/* Sorts nodes by increasing deg, then id, through e, of n entries. The
+ * degrees are copied next to the nodes, so that concurrent orderings do not
+ * share a comparator state */
+static void sort_by_deg(int *nodes, int n, const int *deg, Deg_entry *e) {
+  int k;
+
+  for (k = 0; k < n; ++k) {
+    e[k].deg = deg[nodes[k]];
+    e[k].node = nodes[k];
+  }
+  qsort(e, n, sizeof(Deg_entry), cmp_deg);
+  for (k = 0; k < n; ++k) nodes[k] = e[k].node;
+}
+
+/* Reverse Cuthill-McKee order of the symmetrized graph: a BFS from a
+ * minimum degree node of every component, visiting neighbours by
+ * increasing degree. Returns the list of nodes in visit order reversed */
+static int *rcm_order(const int *from, const int *to, int no_nodes,
+                      eidx no_edges, int no_threads) {
+  int *rows = (int *)malloc(sizeof(int) * 2 * (size_t)no_edges);
+  int *cols = (int *)malloc(sizeof(int) * 2 * (size_t)no_edges);
+  eidx *ptr = (eidx *)malloc(sizeof(eidx) * (no_nodes + 1));
+  int *adj = (int *)malloc(sizeof(int) * 2 * (size_t)no_edges);
+  int *deg = (int *)malloc(sizeof(int) * no_nodes);
+  int *by_deg = (int *)malloc(sizeof(int) * no_nodes);
+  int *order = (int *)malloc(sizeof(int) * no_nodes);
+  char *seen = (char *)calloc(no_nodes, sizeof(char));
+  Deg_entry *e;
+  int head, tail, s, u, tmp, max_deg;
+  eidx ci;
+  int i;
+
+  memcpy(rows, from, sizeof(int) * (size_t)no_edges);
+  memcpy(rows + no_edges, to, sizeof(int) * (size_t)no_edges);
+  memcpy(cols, to, sizeof(int) * (size_t)no_edges);
+  memcpy(cols + no_edges, from, sizeof(int) * (size_t)no_edges);
+  build_csr(rows, cols, no_nodes, 2 * no_edges, 0, no_threads, ptr, adj);
+  free(rows);
+  free(cols);
+
+  max_deg = no_nodes;
+  for (i = 0; i < no_nodes; ++i) {
+    deg[i] = (int)(ptr[i + 1] - ptr[i]);
+    by_deg[i] = i;
+    if (deg[i] > max_deg) max_deg = deg[i];
+  }
+  e = (Deg_entry *)malloc(sizeof(Deg_entry) * ((size_t)max_deg + 1));
+  sort_by_deg(by_deg, no_nodes, deg, e);
+  for (i = 0; i < no_nodes; ++i) sort_by_deg(adj + ptr[i], deg[i], deg, e);
+  free(e);
+
+  head = tail = 0;
+  for (s = 0; s < no_nodes; ++s) {
+    if (seen[by_deg[s]]) continue;
+    seen[by_deg[s]] = 1;
+    order[tail++] = by_deg[s];
+    while (head < tail) {
+      u = order[head++];
+      for (ci = ptr[u]; ci < ptr[u + 1]; ++ci) {
+        if (!seen[adj[ci]]) {
+          seen[adj[ci]] = 1;
+          order[tail++] = adj[ci];
         }
-        SWAP(idx, j - 1, j);
       }
     }
   }
 
-  return idx;
+  for (i = 0; i < no_nodes / 2; ++i) {
+    tmp = order[i];
+    order[i] = order[no_nodes - 1 - i];
+    order[no_nodes - 1 - i] = tmp;
+  }
+
+  free(ptr);
+  free(adj);
+  free(deg);
+  free(by_deg);
+  free(seen);
+  return order;
+}
+
+/* Nodes by decreasing total degree, so that hubs share cache lines */
+static int *degree_order(const int *from, const int *to, int no_nodes,
+                         eidx no_edges) {
+  int *deg = (int *)calloc(no_nodes, sizeof(int));
+  int *cnt;
+  int *order = (int *)malloc(sizeof(int) * no_nodes);
+  int max_deg = 0;
+  int i, d, off, c;
+  eidx e;
+
+  for (e = 0; e < no_edges; ++e) {
+    ++deg[from[e]];
+    ++deg[to[e]];
+  }
+  for (i = 0; i < no_nodes; ++i)
+    if (deg[i] > max_deg) max_deg = deg[i];
+
+  /* Counting sort on the degree, highest first */
+  cnt = (int *)calloc(max_deg + 1, sizeof(int));
+  for (i = 0; i < no_nodes; ++i) ++cnt[deg[i]];
+  off = 0;
+  for (d = max_deg; d >= 0; --d) {
+    c = cnt[d];
+    cnt[d] = off;
+    off += c;
+  }
+  for (i = 0; i < no_nodes; ++i) order[cnt[deg[i]]++] = i;
+
+  free(deg);
+  free(cnt);
+  return order;
+}
+
+/* Relabels the nodes of the edge list according to method ("degree" or
+ * "rcm"). Returns perm, mapping every original id to its new id, or NULL if
+ * the method is unknown or cannot order the graph */
+int *reorder_nodes(int *from, int *to, int no_nodes, eidx no_edges,
+                   const char *method, int no_threads) {
+  int *order, *perm;
+  int i;
+  eidx e;
+
+  if (strcmp(method, "degree") == 0) {
+    order = degree_order(from, to, no_nodes, no_edges);
+  } else if (strcmp(method, "rcm") == 0) {
+    /* The symmetrized graph has twice the edges, which eidx must index */
+    if (no_edges > EIDX_MAX / 2) {
+      fprintf(stderr, " [ERROR] \"rcm\" order of more than %ld edges needs "
+                      "a build with \"make CFLAGS=-DLARGE\"\n",
+              (long)(EIDX_MAX / 2));
+      return NULL;
+    }
+    order = rcm_order(from, to, no_nodes, no_edges, no_threads);
+  } else {
+    fprintf(stderr, " [ERROR] Unknown node order \"%s\"\n", method);
+    return NULL;
+  }
+
+  perm = (int *)malloc(sizeof(int) * no_nodes);
+  for (i = 0; i < no_nodes; ++i) perm[order[i]] = i;
+  free(order);
+
+#pragma omp parallel for num_threads(no_threads)
+  for (e = 0; e < no_edges; ++e) {
+    from[e] = perm[from[e]];
+    to[e] = perm[to[e]];
+  }
+  return perm;
+}
+
+/* Maps the transpose of a CSR matrix, building it from the matrix the first
+ * time it is requested, and again when it is not stamped with stamp, the
+ * cache_stamp() of the matrix */
+int load_transpose(const char ptr_path[], const char ind_path[],
+                   const eidx *row_ptr, const int *col_ind, int no_nodes,
+                   unsigned long stamp, int no_threads, eidx **t_ptr,
+                   int **t_ind) {
+  struct stat st;
+  int *rows, *ind;
+  eidx *ptr;
+  eidx ci;
+  int ri;
+  int err;
+
+  if (stat(ind_path, &st) == -1 ||
+      !check_stamp(ptr_path, sizeof(eidx) * (no_nodes + 1L), stamp)) {
+    printf("Transposing matrix...\n");
+    rows = (int *)malloc(sizeof(int) * (size_t)row_ptr[no_nodes]);
+    ptr = (eidx *)malloc(sizeof(eidx) * (no_nodes + 1));
+    ind = (int *)malloc(sizeof(int) * (size_t)row_ptr[no_nodes]);
+    for (ri = 0; ri < no_nodes; ++ri)
+      for (ci = row_ptr[ri]; ci < row_ptr[ri + 1]; ++ci) rows[ci] = ri;
+    build_csr(col_ind, rows, no_nodes, row_ptr[no_nodes], 1, no_threads, ptr,
+              ind);
+    /* ptr, written last, is the one stamped */
+    err = (write_data(ind_path, ind, sizeof(int), row_ptr[no_nodes]) ==
+           EXIT_FAILURE) ||
+          (write_stamped(ptr_path, ptr, no_nodes + 1, sizeof(eidx), stamp) ==
+           EXIT_FAILURE);
+    free(rows);
+    free(ptr);
+    free(ind);
+    if (err) {
+      remove(ptr_path);
+      remove(ind_path);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if ((*t_ptr = (eidx *)mmap_data(ptr_path, sizeof(eidx), no_nodes + 1)) ==
+      NULL)
+    return EXIT_FAILURE;
+  if ((*t_ind = (int *)mmap_data(ind_path, sizeof(int),
+                                 (*t_ptr)[no_nodes])) == NULL) {
+    munmap(*t_ptr, sizeof(eidx) * (no_nodes + 1));
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
 }
@@ -1,32 +1,160 @@
 #ifndef SHARED_H
 #define SHARED_H
 
+#include <limits.h>
 #include <stddef.h>
 
+/* Precision of the score vectors, "make CFLAGS=-DSINGLE" stores them as
+ * float. Sums and distances are always accumulated in double */
+#ifdef SINGLE
+typedef float real;
+#define TOL 1.e-7
+#else
+typedef double real;
 #define TOL 1.e-10
+#endif
+
+/* Type of the edge counts and of the row offsets of the CSR matrices.
+ * "make CFLAGS=-DLARGE" makes them 64 bit, for graphs of 2^31 edges or
+ * more; node ids, and so the column indices, stay int. The default keeps
+ * the offsets as compact as the column indices. Caches record the width
+ * they were built with */
+#ifdef LARGE
+typedef long eidx;
+#define EIDX_MAX LONG_MAX
+#else
+typedef int eidx;
+#define EIDX_MAX INT_MAX
+#endif
+
 #define MAX_ITER 200
 #define MOD_ITER 10
 #define FNAME 256
 #define DNAME 1024
 #define PATH 1024
-#define MMAP 2048
+#define PROGRESS_STEP (1 << 20)
+#define CMP_TOP_K 100
+
+/* Graph cache container: a header followed by page aligned sections, so
+ * that the whole cache is opened with a single mmap. The header records
+ * the size and modification time of the input file, to detect stale
+ * caches, and a checksum of every section and of itself. The files
+ * derived from a cache (compressed or transposed rows, tiles, blocks) are
+ * stamped with cache_stamp() of the cache they were built from */
+#define CACHE_FILE "graph.bin"
+#define CACHE_MAGIC "IRWSGRF"
+#define CACHE_VERSION 5
+#define CACHE_ALIGN 4096
+#define CACHE_SECTIONS 8
+#define CACHE_DELTAS 16
+
+/* cache_check() results */
+#define CACHE_OK 0
+#define CACHE_MISSING 1
+#define CACHE_STALE 2
+#define CACHE_INVALID 3
+
+/* map_cache() flags */
+#define CACHE_POPULATE 1
+#define CACHE_SEQUENTIAL 2
+#define CACHE_VERIFY 4
 
-/* Data for compression */
 typedef struct {
+  long offset;
+  long size;
+  unsigned long checksum;
+} Cache_section;
+
+typedef struct {
+  char magic[8];
+  int version;
+  /* Size in bytes of the row offsets, sizeof(eidx) */
+  int index_width;
+  /* checksum() of the header itself, computed with this field set to 0 */
+  unsigned long hdr_checksum;
+  long src_size;
+  long src_mtime;
+  long no_edges;
   int no_nodes;
-  int no_edges;
   int no_danglings;
-} CSR_data;
+  int no_sections;
+  /* cache_stamp() of the graph cache a derived container was built from,
+   * 0 in a graph cache */
+  unsigned long stamp;
+  /* file_stamp() of the last delta files merged by updates, oldest first,
+   * so that a delta is not merged twice */
+  int no_deltas;
+  unsigned long delta[CACHE_DELTAS];
+  Cache_section section[CACHE_SECTIONS];
+} Cache_header;
+
+/* Compressed adjacency lists: every row is sorted and stored as the gaps
+ * between consecutive column indices, 7 bits per byte with the high bit set
+ * on all bytes but the last of a value. Row ri starts at byte row_off[ri] */
+#define VB_NEXT(s, x)                    \
+  do {                                   \
+    unsigned int b_, sh_ = 0;            \
+    (x) = 0;                             \
+    do {                                 \
+      b_ = *(s)++;                       \
+      (x) |= (int)((b_ & 0x7f) << sh_);  \
+      sh_ += 7;                          \
+    } while (b_ & 0x80);                 \
+  } while (0)
 
 /* Helper functions */
 int write_data(const char path[], const void *data, size_t nmemb, size_t size);
+int write_stamped(const char path[], const void *data, size_t nmemb,
+                  size_t size, unsigned long stamp);
+int check_stamp(const char path[], long len, unsigned long stamp);
 void delete_folder(const char dir[]);
 void *mmap_data(const char path[], size_t nmemb, size_t size);
-void print_vec_f(const double *v, int n);
+void *mmap_populated(const char path[], size_t nmemb, size_t size);
+void init_cache_header(Cache_header *hdr, const char src_path[]);
+int write_cache(const char path[], Cache_header *hdr, const void *data[],
+                int no_threads);
+int cache_check(const char path[], const char src_path[]);
+Cache_header *map_cache(const char path[], int flags, int no_threads,
+                        size_t *len);
+unsigned long cache_stamp(const Cache_header *hdr);
+unsigned long file_stamp(const char path[], int no_threads);
+int delta_applied(const Cache_header *hdr, unsigned long stamp);
+void record_delta(Cache_header *hdr, const Cache_header *old,
+                  unsigned long stamp);
+int read_edge_list(const char path[], int no_threads, int *no_nodes,
+                   eidx *no_edges, int **from, int **to);
+int read_edge_delta(const char path[], const int *perm, int *no_nodes,
+                    int *no_ins, int **ins_from, int **ins_to, int *no_del,
+                    int **del_from, int **del_to);
+int write_scores(const char path[], const real *v, int n, const int *perm,
+                 const char *phase);
+int read_scores(const char path[], real *v, int n, const int *perm);
+void compare_scores(const real *v, const char ref_path[], int n,
+                    const int *perm, int no_threads);
+void print_vec_f(const real *v, int n);
 void print_vec_d(const int *v, int n);
-void double_merge(int *from, int *to, int lo, int mid, int hi);
-void double_merge_sort(int *from, int *to, int lo, int hi);
-void sort_input_data(int *from, int *to, int n);
-int *index_sort_top_K(const double *v, int n, int top_K);
+void build_csr(const int *rows, const int *cols, int no_nodes, eidx no_edges,
+               int sorted, int no_threads, eidx *row_ptr, int *col_ind);
+eidx merge_csr(const eidx *row_ptr, const int *col_ind, int no_nodes,
+               int new_nodes, const int *ins_rows, const int *ins_cols,
+               int no_ins, int *del_rows, int *del_cols, int *no_del,
+               int sorted, int no_threads, eidx **new_ptr, int **new_ind);
+int *index_sort_top_K(const real *v, int n, int top_K, int no_threads);
+int *select_top_K(const real *v, const int *ids, int n, int top_K,
+                  int no_threads);
+int write_top_K(const char path[], const char csv_path[], const real *v,
+                int n, const int *perm, int top_K, int no_threads,
+                const char *phase);
+int load_vb_csr(const char row_off_path[], const char data_path[],
+                const eidx *row_ptr, const int *col_ind, int no_nodes,
+                unsigned long stamp, long **row_off, unsigned char **data);
+int *reorder_nodes(int *from, int *to, int no_nodes, eidx no_edges,
+                   const char *method, int no_threads);
+int load_transpose(const char ptr_path[], const char ind_path[],
+                   const eidx *row_ptr, const int *col_ind, int no_nodes,
+                   unsigned long stamp, int no_threads, eidx **t_ptr,
+                   int **t_ind);
+void partition_rows(const eidx *row_ptr, int no_nodes, int no_parts,
+                    int *bounds);
 
 #endif